@@ -0,0 +1,376 @@
+/// A FUSE client the Nachos file system.
+///
+/// FUSE (Filesystem in Userspace) is a mechanism for integrating custom
+/// file systems from userspace in POSIX operating systems.  This program
+/// allows the user to mount Nachos' file system in a directory and then
+/// access it using all the standard tools (e.g. commands like `ls` and
+/// `cat`, or graphical file managers).
+///
+/// The client is linked against the objects of the `filesys` build and
+/// boots the Nachos kernel once, when it starts.  Every FUSE operation is
+/// then a direct call into `fileSystem`, and the simulated disk stays open
+/// until the file system is unmounted.  Files can be read, created, written
+/// and removed, and directories can be created, listed and removed.
+///
+/// Some limitations come from the Nachos file system itself:
+///
+/// * file names cannot be longer than `FILE_NAME_MAX_LEN` characters;
+/// * files can grow, but they can only be shrunk to size 0, which is done by
+///   removing the file and creating it again;
+/// * there are no permissions, owners or timestamps.
+///
+/// The kernel is not reentrant, so requests are always served one at a
+/// time (the `-s` FUSE option is implied).
+///
+/// The `DISK` file, which contains the whole simulated disk content, must
+/// be available in the same directory where the FUSE client is executed.
+/// It is recommended to set up a symbolic link to the original in the
+/// `filesys` directory.  If you launch the client with `make mount`, the
+/// link gets created automatically.
+///
+/// Copyright (c) 2018-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#define FUSE_USE_VERSION 26
+#include <fuse.h>
+#include <unistd.h>
+
+#include "filesys/directory.hh"
+#include "filesys/file_header.hh"
+#include "threads/system.hh"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Same well-known sector as in `file_system.cc`.
+static const unsigned DIRECTORY_SECTOR = 1;
+
+/// Number of entries fetched at a time when listing a directory.
+static const unsigned ENTRY_BATCH = 8;
+
+/// Open the file or directory at `path`.  The root directory has no entry
+/// in any directory, so it is opened by its header sector.
+static OpenFile *
+OpenPath(const char *path)
+{
+    if (strcmp(path, "/") == 0)
+        return new OpenFile(DIRECTORY_SECTOR, "Directory");
+    return fileSystem->Open(path);
+}
+
+static inline OpenFile *
+FileOf(const struct fuse_file_info *fi)
+{
+    return (OpenFile *) (uintptr_t) fi->fh;
+}
+
+/// Check that the last component of `path` fits in a directory entry.
+static bool
+NameFits(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return strlen(slash != NULL ? slash + 1 : path) <= FILE_NAME_MAX_LEN;
+}
+
+/// Check whether the directory open in `file` has no entries.
+static bool
+IsEmptyDirectory(OpenFile *file)
+{
+    Directory *dir = new Directory(1);
+    dir->FetchFrom(file);
+    DirectoryEntry entry;
+    unsigned cursor = 0;
+    bool empty = dir->ReadEntries(&cursor, &entry, 1) == 0;
+    delete dir;
+    return empty;
+}
+
+static int
+do_getattr(const char *path, struct stat *st)
+{
+    fprintf(stderr, "[getattr] %s\n", path);
+
+    OpenFile *file = OpenPath(path);
+    if (file == NULL)
+        return -ENOENT;
+    const FileHeader *hdr = file->GetHeader();
+
+    time_t t = time(NULL);
+
+    memset(st, 0, sizeof *st);
+    st->st_uid = getuid();
+    st->st_gid = getgid();
+    st->st_atime = t;
+    st->st_mtime = t;
+    if (hdr->IsDirectory()) {
+        st->st_mode = S_IFDIR | 0755;
+        st->st_nlink = 2;
+    } else {
+        st->st_mode = S_IFREG | 0644;
+        st->st_nlink = 1;
+    }
+    st->st_size = file->Length();
+    st->st_blksize = SECTOR_SIZE;
+    st->st_blocks = hdr->SectorsOnDisk() * SECTOR_SIZE / 512;
+
+    delete file;
+    return 0;
+}
+
+static int
+do_readdir(const char *path, void *buffer, fuse_fill_dir_t fill,
+           off_t offset, struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[readdir] %s\n", path);
+
+    OpenFile *file = OpenPath(path);
+    if (file == NULL)
+        return -ENOENT;
+    if (!file->GetHeader()->IsDirectory()) {
+        delete file;
+        return -ENOTDIR;
+    }
+
+    (*fill)(buffer, ".", NULL, 0);
+    (*fill)(buffer, "..", NULL, 0);
+
+    Directory *dir = new Directory(1);
+    dir->FetchFrom(file);
+    DirectoryEntry entries[ENTRY_BATCH];
+    unsigned cursor = 0, count;
+    while ((count = dir->ReadEntries(&cursor, entries, ENTRY_BATCH)) > 0)
+        for (unsigned i = 0; i < count; i++) {
+            fprintf(stderr, "    %s\n", entries[i].name);
+            (*fill)(buffer, entries[i].name, NULL, 0);
+        }
+
+    delete dir;
+    delete file;
+    return 0;
+}
+
+static int
+do_open(const char *path, struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[open] %s\n", path);
+
+    OpenFile *file = fileSystem->Open(path);
+    if (file == NULL)
+        return -ENOENT;
+    if (file->GetHeader()->IsDirectory()) {
+        delete file;
+        return -EISDIR;
+    }
+    fi->fh = (uintptr_t) file;
+    return 0;
+}
+
+static int
+do_release(const char *path, struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[release] %s\n", path);
+
+    // If the file was unlinked while open, this removes it for good.
+    delete FileOf(fi);
+    return 0;
+}
+
+static int
+do_read(const char *path, char *buffer, size_t size, off_t offset,
+        struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[read] %s\n"
+                    "    size: %zu, start: %jd\n",
+            path, size, (intmax_t) offset);
+
+    if (size == 0)
+        return 0;
+    return FileOf(fi)->ReadAt(buffer, size, offset);
+}
+
+static int
+do_write(const char *path, const char *buffer, size_t size, off_t offset,
+         struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[write] %s\n"
+                    "    size: %zu, start: %jd\n",
+            path, size, (intmax_t) offset);
+
+    if (size == 0)
+        return 0;
+    int written = FileOf(fi)->WriteAt(buffer, size, offset);
+    return written > 0 ? written : -ENOSPC;
+      // Writing past the end fails when the file cannot grow enough.
+}
+
+static int
+do_create(const char *path, mode_t mode, struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[create] %s\n", path);
+
+    if (!NameFits(path))
+        return -ENAMETOOLONG;
+    OpenFile *file = fileSystem->Open(path);
+    if (file != NULL) {
+        delete file;
+        return -EEXIST;
+    }
+    if (!fileSystem->Create(path, 0))
+        return -ENOSPC;
+    return do_open(path, fi);
+}
+
+static int
+do_mkdir(const char *path, mode_t mode)
+{
+    fprintf(stderr, "[mkdir] %s\n", path);
+
+    if (!NameFits(path))
+        return -ENAMETOOLONG;
+    OpenFile *file = OpenPath(path);
+    if (file != NULL) {
+        delete file;
+        return -EEXIST;
+    }
+    return fileSystem->Create(path, 0, true) ? 0 : -ENOSPC;
+}
+
+static int
+do_unlink(const char *path)
+{
+    fprintf(stderr, "[unlink] %s\n", path);
+
+    OpenFile *file = fileSystem->Open(path);
+    if (file == NULL)
+        return -ENOENT;
+    bool isDirectory = file->GetHeader()->IsDirectory();
+    delete file;
+    if (isDirectory)
+        return -EISDIR;
+
+    // `Remove` fails if the file is still open, but then it is removed
+    // when the last `OpenFile` is deleted, which is what UNIX does too.
+    fileSystem->Remove(path);
+    return 0;
+}
+
+static int
+do_rmdir(const char *path)
+{
+    fprintf(stderr, "[rmdir] %s\n", path);
+
+    if (strcmp(path, "/") == 0)
+        return -EBUSY;
+    OpenFile *file = fileSystem->Open(path);
+    if (file == NULL)
+        return -ENOENT;
+    int result = 0;
+    if (!file->GetHeader()->IsDirectory())
+        result = -ENOTDIR;
+    else if (!IsEmptyDirectory(file))
+        result = -ENOTEMPTY;
+    delete file;
+    if (result == 0 && !fileSystem->Remove(path))
+        result = -EBUSY;
+    return result;
+}
+
+static int
+do_truncate(const char *path, off_t size)
+{
+    fprintf(stderr, "[truncate] %s\n"
+                    "    size: %jd\n",
+            path, (intmax_t) size);
+
+    OpenFile *file = fileSystem->Open(path);
+    if (file == NULL)
+        return -ENOENT;
+    if (file->GetHeader()->IsDirectory()) {
+        delete file;
+        return -EISDIR;
+    }
+
+    unsigned length = file->Length();
+    int result = 0;
+    if ((off_t) length < size) {
+        // Grow the file by filling it with zeros.
+        char zeros[SECTOR_SIZE];
+        memset(zeros, 0, sizeof zeros);
+        for (off_t position = length; position < size && result == 0;
+             position += sizeof zeros) {
+            unsigned count = size - position < (off_t) sizeof zeros
+                             ? size - position : sizeof zeros;
+            if (file->WriteAt(zeros, count, position) == 0)
+                result = -ENOSPC;
+        }
+        delete file;
+    } else if ((off_t) length > size) {
+        // Nachos files cannot shrink, but they can be created again empty.
+        FileTableEntry *entry = files->FindBySector(file->GetSector());
+        if (size != 0)
+            result = -EOPNOTSUPP;
+        else if (entry->open > 1)
+            result = -EBUSY;
+        delete file;
+        if (result == 0 && (!fileSystem->Remove(path)
+                            || !fileSystem->Create(path, 0)))
+            result = -EIO;
+    } else
+        delete file;
+    return result;
+}
+
+static int
+do_utimens(const char *path, const struct timespec tv[2])
+{
+    fprintf(stderr, "[utimens] %s\n", path);
+
+    // There are no timestamps to update, but `touch` expects this to work.
+    OpenFile *file = OpenPath(path);
+    if (file == NULL)
+        return -ENOENT;
+    delete file;
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    // Boot the kernel.  Nachos catches `SIGINT` to halt; hand it back to
+    // FUSE, so that interrupting the client unmounts the file system.
+    char *nachosArgv[] = { argv[0], NULL };
+    Initialize(1, nachosArgv);
+    signal(SIGINT, SIG_DFL);
+
+    // Serve one request at a time.
+    char **fuseArgv = new char * [argc + 2];
+    for (int i = 0; i < argc; i++)
+        fuseArgv[i] = argv[i];
+    fuseArgv[argc] = (char *) "-s";
+    fuseArgv[argc + 1] = NULL;
+
+    struct fuse_operations operations;
+    memset(&operations, 0, sizeof operations);
+    operations.getattr  = do_getattr;
+    operations.readdir  = do_readdir;
+    operations.open     = do_open;
+    operations.release  = do_release;
+    operations.read     = do_read;
+    operations.write    = do_write;
+    operations.create   = do_create;
+    operations.mkdir    = do_mkdir;
+    operations.unlink   = do_unlink;
+    operations.rmdir    = do_rmdir;
+    operations.truncate = do_truncate;
+    operations.utimens  = do_utimens;
+
+    return fuse_main(argc + 1, fuseArgv, &operations, NULL);
+}
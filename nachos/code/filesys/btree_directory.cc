@@ -0,0 +1,401 @@
+/// Routines to manage a directory stored as a B+-tree.
+///
+/// Every node of the tree occupies exactly one block of the directory file,
+/// and blocks have the size of a disk sector, so reading or writing a node
+/// is a single sector transfer.  The header in block 0 is only rewritten
+/// when the tree grows a new node.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "btree_directory.hh"
+
+#include <string.h>
+
+
+/// Cursors encode a leaf block and a position inside it.
+static const unsigned CURSOR_BASE = BTREE_LEAF_ORDER + 1;
+
+static inline int
+CompareNames(const char *a, const char *b)
+{
+    return strncmp(a, b, FILE_NAME_MAX_LEN);
+}
+
+static inline void
+CopyName(char *to, const char *from)
+{
+    strncpy(to, from, FILE_NAME_MAX_LEN);
+    to[FILE_NAME_MAX_LEN] = '\0';
+}
+
+/// Index of the child of an internal node that leads to `name`.
+static unsigned
+ChildIndex(const RawBTreeNode *node, const char *name)
+{
+    unsigned i = 0;
+    while (i < node->count && CompareNames(node->inner.keys[i], name) <= 0)
+        i++;
+    return i;
+}
+
+BTreeDirectory::BTreeDirectory(OpenFile *file_)
+{
+    ASSERT(file_ != nullptr);
+    ASSERT(sizeof (RawBTreeNode) <= SECTOR_SIZE);
+
+    file = file_;
+    file->ReadAt((char *) &header, sizeof header, 0);
+    ASSERT(header.magic == BTREE_MAGIC);
+}
+
+/* Escribe en `file` un árbol vacío: el bloque de cabecera y una hoja raíz
+   sin entradas. */
+void
+BTreeDirectory::Format(OpenFile *file)
+{
+    ASSERT(file != nullptr);
+
+    RawBTreeHeader h;
+    h.magic     = BTREE_MAGIC;
+    h.root      = 1;
+    h.firstLeaf = 1;
+    h.numBlocks = 2;
+
+    char block[SECTOR_SIZE];
+    memset(block, 0, sizeof block);
+    memcpy(block, &h, sizeof h);
+    file->WriteAt(block, SECTOR_SIZE, 0);
+
+    memset(block, 0, sizeof block);
+    ((RawBTreeNode *) block)->isLeaf = 1;
+    file->WriteAt(block, SECTOR_SIZE, SECTOR_SIZE);
+}
+
+void
+BTreeDirectory::ReadNode(unsigned block, RawBTreeNode *node)
+{
+    ASSERT(block != 0 && block < header.numBlocks);
+    file->ReadAt((char *) node, sizeof *node, block * SECTOR_SIZE);
+}
+
+void
+BTreeDirectory::WriteNode(unsigned block, const RawBTreeNode *node)
+{
+    ASSERT(block != 0 && block < header.numBlocks);
+    file->WriteAt((const char *) node, sizeof *node, block * SECTOR_SIZE);
+}
+
+void
+BTreeDirectory::WriteHeader()
+{
+    file->WriteAt((const char *) &header, sizeof header, 0);
+}
+
+/* Reserva un bloque nuevo al final del archivo.  Se escribe un nodo vacío
+   para que el archivo crezca en ese momento; si no hay lugar en el disco,
+   se devuelve 0. */
+unsigned
+BTreeDirectory::AllocateNode()
+{
+    RawBTreeNode empty;
+    memset(&empty, 0, sizeof empty);
+
+    unsigned block = header.numBlocks;
+    if (file->WriteAt((const char *) &empty, sizeof empty,
+                      block * SECTOR_SIZE) == 0) {
+        DEBUG('f', "No space left to grow the directory tree.\n");
+        return 0;
+    }
+    header.numBlocks++;
+    WriteHeader();
+    return block;
+}
+
+unsigned
+BTreeDirectory::FindLeaf(const char *name, RawBTreeNode *leaf)
+{
+    unsigned block = header.root;
+    ReadNode(block, leaf);
+    while (!leaf->isLeaf) {
+        block = leaf->inner.children[ChildIndex(leaf, name)];
+        ReadNode(block, leaf);
+    }
+    return block;
+}
+
+int
+BTreeDirectory::Find(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    RawBTreeNode leaf;
+    FindLeaf(name, &leaf);
+    for (unsigned i = 0; i < leaf.count; i++)
+        if (CompareNames(leaf.entries[i].name, name) == 0)
+            return leaf.entries[i].sector;
+    return -1;
+}
+
+/* Se divide cada nodo lleno del camino, desde la hoja hacia arriba, hasta
+   el primero que tiene lugar; si todos están llenos, la raíz nueva ocupa
+   un bloque más. */
+unsigned
+BTreeDirectory::NodesNeeded(const char *name)
+{
+    RawBTreeNode node;
+    unsigned block = header.root, needed = 0, depth = 0;
+    for (;;) {
+        ReadNode(block, &node);
+        depth++;
+        bool full = node.count == (node.isLeaf ? BTREE_LEAF_ORDER
+                                               : BTREE_INNER_ORDER);
+        needed = full ? needed + 1 : 0;
+        if (node.isLeaf)
+            break;
+        block = node.inner.children[ChildIndex(&node, name)];
+    }
+    // Every node on the path is full, the root included.
+    if (needed == depth)
+        needed++;
+    return needed;
+}
+
+/* Los bloques se escriben para que el archivo crezca, pero `numBlocks`
+   vuelve a su valor: `AllocateNode` los toma después sin tener que agrandar
+   el archivo, así que no puede fallar.  Si el disco se llena a mitad de
+   camino, los bloques ya agregados quedan en el archivo para la próxima. */
+bool
+BTreeDirectory::ReserveNodes(unsigned count)
+{
+    unsigned first = header.numBlocks;
+    bool reserved = true;
+    for (unsigned i = 0; i < count && reserved; i++)
+        reserved = AllocateNode() != 0;
+    header.numBlocks = first;
+    WriteHeader();
+    return reserved;
+}
+
+/* Inserta recursivamente.  Cada nivel lee y escribe un único nodo, salvo
+   cuando se divide, en cuyo caso escribe también el hermano nuevo y le
+   informa al padre la clave separadora.  Si no se puede reservar el bloque
+   del hermano, el nodo no se toca. */
+BTreeDirectory::InsertResult
+BTreeDirectory::Insert(unsigned block, const DirectoryEntry *entry,
+                       char *upKey, unsigned *upBlock)
+{
+    RawBTreeNode node;
+    ReadNode(block, &node);
+
+    if (node.isLeaf) {
+        unsigned pos = 0;
+        while (pos < node.count
+               && CompareNames(node.entries[pos].name, entry->name) < 0)
+            pos++;
+
+        if (node.count < BTREE_LEAF_ORDER) {
+            memmove(&node.entries[pos + 1], &node.entries[pos],
+                    (node.count - pos) * sizeof (DirectoryEntry));
+            node.entries[pos] = *entry;
+            node.count++;
+            WriteNode(block, &node);
+            return INSERT_DONE;
+        }
+
+        // The leaf is full: split it in two.
+        unsigned newBlock = AllocateNode();
+        if (newBlock == 0)
+            return INSERT_FULL;
+
+        DirectoryEntry all[BTREE_LEAF_ORDER + 1];
+        memcpy(all, node.entries, pos * sizeof (DirectoryEntry));
+        all[pos] = *entry;
+        memcpy(&all[pos + 1], &node.entries[pos],
+               (node.count - pos) * sizeof (DirectoryEntry));
+
+        unsigned leftCount = (BTREE_LEAF_ORDER + 1) / 2;
+        RawBTreeNode sibling;
+        memset(&sibling, 0, sizeof sibling);
+        sibling.isLeaf = 1;
+        sibling.count = BTREE_LEAF_ORDER + 1 - leftCount;
+        sibling.next = node.next;
+        memcpy(sibling.entries, &all[leftCount],
+               sibling.count * sizeof (DirectoryEntry));
+
+        node.count = leftCount;
+        node.next = newBlock;
+        memcpy(node.entries, all, leftCount * sizeof (DirectoryEntry));
+
+        WriteNode(newBlock, &sibling);
+        WriteNode(block, &node);
+        CopyName(upKey, sibling.entries[0].name);
+        *upBlock = newBlock;
+        return INSERT_SPLIT;
+    }
+
+    unsigned idx = ChildIndex(&node, entry->name);
+    char childKey[FILE_NAME_MAX_LEN + 1];
+    unsigned childBlock;
+    InsertResult result = Insert(node.inner.children[idx], entry,
+                                 childKey, &childBlock);
+    if (result != INSERT_SPLIT)
+        return result;
+
+    if (node.count < BTREE_INNER_ORDER) {
+        memmove(node.inner.keys[idx + 1], node.inner.keys[idx],
+                (node.count - idx) * (FILE_NAME_MAX_LEN + 1));
+        memmove(&node.inner.children[idx + 2], &node.inner.children[idx + 1],
+                (node.count - idx) * sizeof (unsigned));
+        CopyName(node.inner.keys[idx], childKey);
+        node.inner.children[idx + 1] = childBlock;
+        node.count++;
+        WriteNode(block, &node);
+        return INSERT_DONE;
+    }
+
+    // The internal node is full: split it and push the middle key up.
+    unsigned newBlock = AllocateNode();
+    if (newBlock == 0)
+        return INSERT_FULL;
+
+    char keys[BTREE_INNER_ORDER + 1][FILE_NAME_MAX_LEN + 1];
+    unsigned children[BTREE_INNER_ORDER + 2];
+    for (unsigned i = 0, j = 0; i <= BTREE_INNER_ORDER; i++)
+        CopyName(keys[i], i == idx ? childKey : node.inner.keys[j++]);
+    for (unsigned i = 0, j = 0; i <= BTREE_INNER_ORDER + 1; i++)
+        children[i] = i == idx + 1 ? childBlock : node.inner.children[j++];
+
+    unsigned mid = (BTREE_INNER_ORDER + 1) / 2;
+    RawBTreeNode sibling;
+    memset(&sibling, 0, sizeof sibling);
+    sibling.count = BTREE_INNER_ORDER - mid;
+    for (unsigned i = 0; i < sibling.count; i++)
+        CopyName(sibling.inner.keys[i], keys[mid + 1 + i]);
+    for (unsigned i = 0; i <= sibling.count; i++)
+        sibling.inner.children[i] = children[mid + 1 + i];
+
+    node.count = mid;
+    for (unsigned i = 0; i < mid; i++)
+        CopyName(node.inner.keys[i], keys[i]);
+    for (unsigned i = 0; i <= mid; i++)
+        node.inner.children[i] = children[i];
+
+    WriteNode(newBlock, &sibling);
+    WriteNode(block, &node);
+    CopyName(upKey, keys[mid]);
+    *upBlock = newBlock;
+    return INSERT_SPLIT;
+}
+
+bool
+BTreeDirectory::Add(const char *name, int newSector)
+{
+    ASSERT(name != nullptr);
+
+    RawBTreeNode leaf;
+    FindLeaf(name, &leaf);
+    for (unsigned i = 0; i < leaf.count; i++)
+        if (CompareNames(leaf.entries[i].name, name) == 0)
+            return false;
+
+    DirectoryEntry entry;
+    memset(&entry, 0, sizeof entry);
+    entry.inUse = true;
+    entry.sector = newSector;
+    CopyName(entry.name, name);
+
+    // Every block the insertion needs is reserved first: a split that
+    // could not be completed higher up would lose the new sibling.
+    if (!ReserveNodes(NodesNeeded(name)))
+        return false;
+
+    char upKey[FILE_NAME_MAX_LEN + 1];
+    unsigned upBlock;
+    InsertResult result = Insert(header.root, &entry, upKey, &upBlock);
+    if (result == INSERT_FULL)
+        return false;
+    if (result == INSERT_SPLIT) {
+        // The root was split; the tree grows one level.
+        unsigned newRoot = AllocateNode();
+        if (newRoot == 0)
+            return false;
+
+        RawBTreeNode root;
+        memset(&root, 0, sizeof root);
+        root.count = 1;
+        CopyName(root.inner.keys[0], upKey);
+        root.inner.children[0] = header.root;
+        root.inner.children[1] = upBlock;
+        WriteNode(newRoot, &root);
+
+        header.root = newRoot;
+        WriteHeader();
+    }
+    return true;
+}
+
+/* Quita la entrada de su hoja.  Las hojas no se fusionan: una hoja vacía
+   sigue en la cadena y se reutiliza en inserciones posteriores. */
+bool
+BTreeDirectory::Remove(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    RawBTreeNode leaf;
+    unsigned block = FindLeaf(name, &leaf);
+    for (unsigned i = 0; i < leaf.count; i++)
+        if (CompareNames(leaf.entries[i].name, name) == 0) {
+            memmove(&leaf.entries[i], &leaf.entries[i + 1],
+                    (leaf.count - i - 1) * sizeof (DirectoryEntry));
+            leaf.count--;
+            WriteNode(block, &leaf);
+            return true;
+        }
+    return false;
+}
+
+/* Recorre la cadena de hojas a partir del cursor.  Como en `readdir` de
+   UNIX, las entradas agregadas o quitadas entre dos llamadas pueden
+   omitirse o repetirse. */
+int
+BTreeDirectory::ReadEntries(unsigned *cursor, DirectoryEntry *entries,
+                            unsigned maxEntries)
+{
+    ASSERT(cursor != nullptr);
+    ASSERT(entries != nullptr);
+
+    unsigned block, index;
+    RawBTreeNode leaf;
+    if (*cursor == 0) {
+        block = header.firstLeaf;
+        index = 0;
+        ReadNode(block, &leaf);
+    } else {
+        // The cursor may come from a user program: check it before
+        // reading the node it names.
+        block = *cursor / CURSOR_BASE;
+        index = *cursor % CURSOR_BASE;
+        if (block == 0 || block >= header.numBlocks)
+            return -1;
+        ReadNode(block, &leaf);
+        if (!leaf.isLeaf || index > leaf.count)
+            return -1;
+    }
+
+    unsigned count = 0;
+    for (;;) {
+        for (; index < leaf.count && count < maxEntries; index++)
+            entries[count++] = leaf.entries[index];
+        if (index < leaf.count || leaf.next == 0 || count == maxEntries)
+            break;
+        block = leaf.next;
+        index = 0;
+        ReadNode(block, &leaf);
+    }
+
+    *cursor = block * CURSOR_BASE + index;
+    return count;
+}
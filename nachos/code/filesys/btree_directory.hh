@@ -0,0 +1,138 @@
+/// Data structures for directories stored on disk as a B+-tree.
+///
+/// The linear directory format keeps the whole table in one array that has
+/// to be read and written as a unit, so every operation costs as many disk
+/// sectors as the directory has.  A B+-tree directory instead splits the
+/// entries among nodes of exactly one sector each, and every operation works
+/// directly on the nodes it needs:
+///
+/// * lookup, insertion and removal touch one node per level of the tree;
+/// * listing walks the chain of leaves, one sector at a time.
+///
+/// Nodes are stored as blocks inside the directory file itself, so the
+/// directory grows through the usual file expansion mechanism.  Block 0
+/// holds a small header with the location of the root.
+///
+/// Removal is lazy: entries are taken out of their leaf, but leaves are
+/// never merged.  Empty leaves are kept in the chain and reused by later
+/// insertions that fall into their key range.
+///
+/// We assume mutual exclusion is provided by the caller.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_BTREEDIRECTORY__HH
+#define NACHOS_FILESYS_BTREEDIRECTORY__HH
+
+
+#include "directory_entry.hh"
+#include "open_file.hh"
+#include "machine/disk.hh"
+
+
+/// Number of entries that fit in a leaf node.
+const unsigned BTREE_LEAF_ORDER
+  = (SECTOR_SIZE - 2 * sizeof (unsigned)) / sizeof (DirectoryEntry);
+
+/// Number of separator keys that fit in an internal node.
+const unsigned BTREE_INNER_ORDER
+  = (SECTOR_SIZE - 3 * sizeof (unsigned))
+    / (FILE_NAME_MAX_LEN + 1 + sizeof (unsigned));
+
+/// Identifies the header block of a B+-tree directory.
+const unsigned BTREE_MAGIC = 0x42545245;
+
+/// Contents of block 0 of a B+-tree directory file.
+struct RawBTreeHeader {
+    unsigned magic;
+    unsigned root;  ///< Block number of the root node.
+    unsigned firstLeaf;  ///< Leftmost leaf, where listings start.
+    unsigned numBlocks;  ///< Blocks in use, including this header.
+};
+
+/// A node of the tree, as stored on disk.  Block number 0 is never a node,
+/// so it is used as the null pointer.
+struct RawBTreeNode {
+    unsigned short isLeaf;
+    unsigned short count;  ///< Entries (leaf) or separator keys (internal).
+    unsigned next;  ///< Next leaf in key order; unused in internal nodes.
+    union {
+        /// Leaf nodes: entries sorted by name.
+        DirectoryEntry entries[BTREE_LEAF_ORDER];
+        /// Internal nodes: `keys[i]` is the smallest name reachable
+        /// through `children[i + 1]`.
+        struct {
+            char keys[BTREE_INNER_ORDER][FILE_NAME_MAX_LEN + 1];
+            unsigned children[BTREE_INNER_ORDER + 1];
+        } inner;
+    };
+};
+
+
+class BTreeDirectory {
+public:
+
+    /// Attach to the B+-tree stored in `file`.  Only the header block is
+    /// read.
+    BTreeDirectory(OpenFile *file);
+
+    /// Write an empty tree into `file`.
+    static void Format(OpenFile *file);
+
+    /// Find the sector number of the `FileHeader` for file: `name`.
+    int Find(const char *name);
+
+    /// Add a file name into the directory.
+    bool Add(const char *name, int newSector);
+
+    /// Remove a file from the directory.
+    bool Remove(const char *name);
+
+    /// Copy up to `maxEntries` entries into `entries`, starting at the
+    /// position recorded in `cursor`, and advance the cursor.  A cursor
+    /// equal to 0 starts at the first entry.  Return the number of entries
+    /// copied; 0 means the end of the directory was reached, and -1 that
+    /// `cursor` does not point into a leaf, in which case it is left alone.
+    int ReadEntries(unsigned *cursor, DirectoryEntry *entries,
+                    unsigned maxEntries);
+
+private:
+    void ReadNode(unsigned block, RawBTreeNode *node);
+    void WriteNode(unsigned block, const RawBTreeNode *node);
+    void WriteHeader();
+
+    /// Reserve a new block at the end of the file.
+    unsigned AllocateNode();
+
+    /// Descend from the root to the leaf that may contain `name`.
+    unsigned FindLeaf(const char *name, RawBTreeNode *leaf);
+
+    /// Number of blocks that inserting `name` allocates: one for every
+    /// full node that is split, and one more for a new root.
+    unsigned NodesNeeded(const char *name);
+
+    /// Make the file big enough for `count` more blocks, without using
+    /// them yet.  Return false if the disk is full.
+    bool ReserveNodes(unsigned count);
+
+    /// Outcome of `Insert`.
+    enum InsertResult {
+        INSERT_DONE,   ///< The entry was inserted.
+        INSERT_SPLIT,  ///< Inserted, and the root of the subtree was split.
+        INSERT_FULL    ///< Not inserted: a block could not be allocated.
+    };
+
+    /// Insert `entry` in the subtree rooted at `block`.  If the root of the
+    /// subtree had to be split, store the separator key and the new sibling
+    /// in `upKey` and `upBlock`.
+    InsertResult Insert(unsigned block, const DirectoryEntry *entry,
+                        char *upKey, unsigned *upBlock);
+
+    OpenFile *file;
+    RawBTreeHeader header;
+};
+
+
+#endif
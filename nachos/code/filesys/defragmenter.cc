@@ -0,0 +1,254 @@
+/// Routines for the online defragmenter.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "defragmenter.hh"
+#include "directory.hh"
+#include "file_header.hh"
+#include "lib/bitmap.hh"
+#include "machine/disk.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/// Same well-known sectors as in `file_system.cc`.
+static const unsigned FREE_MAP_SECTOR = 0;
+static const unsigned DIRECTORY_SECTOR = 1;
+
+/// Room for a path relative to the root.
+static const unsigned PATH_MAX_LEN = 128;
+
+Defragmenter::Defragmenter(double threshold_)
+{
+    threshold = threshold_;
+    freeMapFile = nullptr;
+    filesSeen = filesMoved = seeksBefore = seeksAfter = 0;
+}
+
+static void
+DefragmenterThread(void *arg)
+{
+    ((Defragmenter *) arg)->Run();
+}
+
+void
+Defragmenter::Start()
+{
+    Thread *t = new Thread("defragmenter");
+    t->Fork(DefragmenterThread, this);
+}
+
+double
+Defragmenter::FragmentationScore(const unsigned *sectors, unsigned count)
+{
+    ASSERT(sectors != nullptr || count == 0);
+
+    if (count < 2)
+        return 0;
+    unsigned breaks = 0;
+    for (unsigned i = 1; i < count; i++)
+        if (sectors[i] != sectors[i - 1] + 1)
+            breaks++;
+    return (double) breaks / (count - 1);
+}
+
+unsigned
+Defragmenter::TrackChanges(unsigned header, const unsigned *sectors,
+                           unsigned count)
+{
+    ASSERT(sectors != nullptr || count == 0);
+
+    unsigned changes = 0, previous = header;
+    for (unsigned i = 0; i < count; i++) {
+        if (sectors[i] / SECTORS_PER_TRACK != previous / SECTORS_PER_TRACK)
+            changes++;
+        previous = sectors[i];
+    }
+    return changes;
+}
+
+/* Una pasada completa: recorre el árbol de directorios a partir de la
+   raíz e informa cuántos cambios de pista ahorra la lectura secuencial de
+   los archivos movidos. */
+void
+Defragmenter::Run()
+{
+    filesSeen = filesMoved = seeksBefore = seeksAfter = 0;
+    unsigned long diskSeeks = stats->numDiskSeeks;
+
+    freeMapFile = new OpenFile(FREE_MAP_SECTOR, "FreeMap");
+    ScanDirectory(DIRECTORY_SECTOR, "");
+    delete freeMapFile;
+    freeMapFile = nullptr;
+
+    printf("Defragmenter: %u files examined, %u moved.\n"
+           "  Track changes to read the moved files: %u before, %u after.\n"
+           "  Disk seeks during the pass: %lu.\n",
+           filesSeen, filesMoved, seeksBefore, seeksAfter,
+           stats->numDiskSeeks - diskSeeks);
+}
+
+void
+Defragmenter::ScanDirectory(unsigned dirSector, const char *path)
+{
+    ASSERT(path != nullptr);
+
+    OpenFile  *dirFile = new OpenFile(dirSector, "DefragDirectory");
+    Directory *dir     = new Directory(1);
+    dir->FetchFrom(dirFile);
+
+    DirectoryEntry entries[Directory::ENTRY_BATCH];
+    unsigned cursor = 0, count;
+    while ((count = dir->ReadEntries(&cursor, entries,
+                                     Directory::ENTRY_BATCH)) > 0)
+        for (unsigned i = 0; i < count; i++) {
+            char childPath[PATH_MAX_LEN];
+            snprintf(childPath, sizeof childPath, "%s%s%s",
+                     path, path[0] != '\0' ? "/" : "", entries[i].name);
+            filesSeen++;
+            Defragment(dirSector, entries[i].name, entries[i].sector,
+                       childPath);
+
+            FileHeader *h = new FileHeader;
+            h->FetchFrom(entries[i].sector);
+            bool isDirectory = h->IsDirectory();
+            delete h;
+            if (isDirectory)
+                ScanDirectory(entries[i].sector, childPath);
+
+            currentThread->Yield();
+        }
+
+    delete dir;
+    delete dirFile;
+}
+
+/// Check that `name` still refers to the header at `sector`.
+static bool
+StillListed(unsigned dirSector, const char *name, unsigned sector)
+{
+    OpenFile  *dirFile = new OpenFile(dirSector, "DefragDirectory");
+    Directory *dir     = new Directory(1);
+    dir->FetchFrom(dirFile);
+    bool listed = dir->Find(name) == (int) sector;
+    delete dir;
+    delete dirFile;
+    return listed;
+}
+
+/// Close `file`, and free `linkName` unless it is still the name of an
+/// entry in the table of open files.
+static void
+CloseFile(OpenFile *file, unsigned sector, char *linkName)
+{
+    delete file;
+    FileTableEntry *entry = files->FindBySector(sector);
+    if (entry == nullptr || entry->name != linkName)
+        delete [] linkName;
+}
+
+/* Mueve el archivo a una corrida contigua.  Se copia con el lock de
+   escritura tomado, pero el encabezado sólo se escribe si, con el lock del
+   bitmap tomado, el archivo sigue igual que al empezar. */
+void
+Defragmenter::Defragment(unsigned dirSector, const char *name,
+                         unsigned sector, const char *path)
+{
+    // Keeping the file open also stops `Remove` from freeing it; if it is
+    // removed meanwhile, closing it removes it by this name.
+    char *linkName = new char [strlen(path) + 1];
+    strcpy(linkName, path);
+    OpenFile *file = new OpenFile(sector, linkName);
+    FileTableEntry *entry = files->FindBySector(sector);
+    entry->RequestWrite();
+
+    FileHeader *hdr = new FileHeader;
+    hdr->FetchFrom(sector);
+    unsigned total = hdr->SectorsOnDisk();
+    unsigned *sectors = new unsigned [total + 1];
+
+    if (total < 2 || entry->deleted || !StillListed(dirSector, name, sector)) {
+        entry->WriterFree();
+        delete [] sectors;
+        delete hdr;
+        CloseFile(file, sector, linkName);
+        return;
+    }
+
+    hdr->ListSectors(sectors);
+    double score = FragmentationScore(sectors, total);
+    DEBUG('f', "Defragmenter: %s uses %u sectors, score %.2f.\n",
+          path, total, score);
+
+    int first = -1;
+    Bitmap *freeMap = new Bitmap(NUM_SECTORS);
+    if (score > threshold) {
+        freeMapLock->Acquire();
+        freeMap->FetchFrom(freeMapFile);
+        // Every access reads the header too, so stay near it.
+        first = freeMap->FindContiguous(total, sector);
+        if (first != -1)
+            freeMap->WriteBack(freeMapFile);
+        freeMapLock->Release();
+        if (first == -1)
+            DEBUG('f', "Defragmenter: no run of %u free sectors for %s.\n",
+                  total, path);
+    }
+
+    if (first != -1) {
+        // Copy the blocks, giving foreground threads a chance between
+        // every transfer.
+        char buffer[SECTOR_SIZE];
+        for (unsigned i = 0; i < total; i++) {
+            synchDisk->ReadSector(sectors[i], buffer);
+            synchDisk->WriteSector(first + i, buffer);
+            currentThread->Yield();
+        }
+
+        freeMapLock->Acquire();
+        freeMap->FetchFrom(freeMapFile);
+        FileHeader *current = new FileHeader;
+        current->FetchFrom(sector);
+        bool valid = !entry->deleted && freeMap->Test(sector)
+                     && memcmp(current->GetRaw(), hdr->GetRaw(),
+                               sizeof (RawFileHeader)) == 0;
+        for (unsigned i = 0; i < total; i++)
+            valid = valid && freeMap->Test(sectors[i]);
+        delete current;
+
+        if (valid) {
+            hdr->Relocate(first);
+            hdr->WriteBack(sector);  // Commit point.
+            for (unsigned i = 0; i < total; i++)
+                freeMap->Clear(sectors[i]);
+
+            unsigned before = TrackChanges(sector, sectors, total);
+            for (unsigned i = 0; i < total; i++)
+                sectors[i] = first + i;
+            unsigned after = TrackChanges(sector, sectors, total);
+            seeksBefore += before;
+            seeksAfter  += after;
+            filesMoved++;
+            DEBUG('f', "Defragmenter: moved %s to sectors %d-%u, "
+                  "track changes %u -> %u.\n",
+                  path, first, first + total - 1, before, after);
+        } else {
+            DEBUG('f', "Defragmenter: %s changed while moving it.\n", path);
+            for (unsigned i = 0; i < total; i++)
+                freeMap->Clear(first + i);
+        }
+        freeMap->WriteBack(freeMapFile);
+        freeMapLock->Release();
+    }
+
+    entry->WriterFree();
+    delete freeMap;
+    delete [] sectors;
+    delete hdr;
+    CloseFile(file, sector, linkName);
+}
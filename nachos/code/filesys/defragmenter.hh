@@ -0,0 +1,82 @@
+/// Online defragmentation of the Nachos file system.
+///
+/// `FileHeader::Allocate` takes the first free sector for every block, so
+/// after files are created, grown and removed, the blocks of a file end up
+/// scattered over many tracks, and reading it sequentially pays a seek
+/// almost every sector.
+///
+/// The defragmenter is a kernel thread that walks the directory tree and,
+/// for every file whose fragmentation score is above a threshold, moves the
+/// whole file (data and index blocks) to a single run of free sectors:
+///
+/// 1. the run is reserved in the bitmap of free sectors;
+/// 2. the blocks are copied while holding the file's write lock, yielding
+///    the CPU after every sector so that foreground threads are not held
+///    back;
+/// 3. the file header is written back pointing at the new run -- this is
+///    the commit point: until then, the file still uses its old blocks;
+/// 4. the old blocks are released.
+///
+/// Steps 3 and 4 happen under `freeMapLock`, after checking that the file
+/// was neither removed nor changed in the meantime; otherwise the move is
+/// abandoned and the run is released.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_DEFRAGMENTER__HH
+#define NACHOS_FILESYS_DEFRAGMENTER__HH
+
+
+#include "open_file.hh"
+
+
+/// Files whose score is above this value are moved.
+const double DEFRAG_THRESHOLD = 0.1;
+
+class Defragmenter {
+public:
+
+    /// Initialize a defragmenter that moves files whose fragmentation score
+    /// is above `threshold`.
+    Defragmenter(double threshold = DEFRAG_THRESHOLD);
+
+    /// Fork a kernel thread that does one pass over the file system, prints
+    /// a report and finishes.
+    void Start();
+
+    /// Do one pass over every file in the file system.
+    void Run();
+
+    /// Fraction of consecutive pairs in `sectors` that are not adjacent on
+    /// disk: 0 for a contiguous file, 1 when no two blocks are adjacent.
+    static double FragmentationScore(const unsigned *sectors, unsigned count);
+
+    /// Number of track changes needed to read the file header at `header`
+    /// and then visit `sectors` in order.
+    static unsigned TrackChanges(unsigned header, const unsigned *sectors,
+                                 unsigned count);
+
+private:
+
+    /// Defragment every file listed in the directory at `dirSector`.
+    /// `path` is the path of the directory, relative to the root.
+    void ScanDirectory(unsigned dirSector, const char *path);
+
+    /// Move the file `name`, whose header is at `sector` and which is
+    /// listed in the directory at `dirSector`, if it is fragmented.
+    void Defragment(unsigned dirSector, const char *name, unsigned sector,
+                    const char *path);
+
+    double threshold;
+    OpenFile *freeMapFile;
+
+    unsigned filesSeen;
+    unsigned filesMoved;
+    unsigned seeksBefore;  ///< Track changes to read the moved files before.
+    unsigned seeksAfter;   ///< Track changes to read the moved files after.
+};
+
+
+#endif
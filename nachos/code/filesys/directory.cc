@@ -21,6 +21,7 @@
 
 
 #include "directory.hh"
+#include "btree_directory.hh"
 #include "directory_entry.hh"
 #include "file_header.hh"
 #include "lib/utility.hh"
@@ -34,13 +35,16 @@
 /// otherwise, we need to call FetchFrom in order to initialize it from disk.
 ///
 /// * `size` is the number of entries in the directory.
+/// * `format` is the layout written by `WriteBack` for a new directory.
 
 /* Se modificó la estructura de la tabla que está asociada al directorio, para que sea dinámica.
     Se reserva el primer byte del archivo que guarda la informacion del directorio, para persistir
     el tamaño de la tabla.*/
-Directory::Directory(unsigned size)
+Directory::Directory(unsigned size, DirectoryFormat format_)
 {
     ASSERT(size > 0);
+    format = format_;
+    tree = nullptr;
     raw.table = (DirectoryEntry*) malloc(sizeof(DirectoryEntry) * size); 
     raw.tableSize = size;
     for (unsigned i = 0; i < raw.tableSize; i++)
@@ -50,6 +54,7 @@ Directory::Directory(unsigned size)
 /// De-allocate directory data structure.
 Directory::~Directory()
 {
+    delete tree;
     delete [] raw.table;
 }
 
@@ -58,12 +63,22 @@ Directory::~Directory()
 /// * `file` is file containing the directory contents.
 
 /* Lee el contenido de un directorio de manera dinamica, en el 0 del archivo está el tableSize. 
-   Se utiliza realloc ya que el puntero puede necesitar mas espacio de memoria contiguo. */
+   Se utiliza realloc ya que el puntero puede necesitar mas espacio de memoria contiguo.
+   Si el directorio es un árbol B+ no se lee la tabla: sólo se asocia el árbol al archivo. */
 void
 Directory::FetchFrom(OpenFile *file)
 {
     ASSERT(file != nullptr);
     DEBUG('f', "Fetching Directory from file (%u)\n", file->GetSector());
+
+    delete tree;
+    tree = nullptr;
+    format = file->GetHeader()->GetDirectoryFormat();
+    if (format == BTREE_DIRECTORY) {
+        tree = new BTreeDirectory(file);
+        return;
+    }
+
     file->ReadAt((char *) &raw.tableSize, 1, 0);
     DEBUG('f', "Directory table size: %d\n", raw.tableSize);
     raw.table = (DirectoryEntry*) realloc(raw.table, raw.tableSize * sizeof(DirectoryEntry));
@@ -83,12 +98,21 @@ Directory::FetchFrom(OpenFile *file)
 ///
 /// * `file` is a file to contain the new directory contents.
 
-/* De manera inversa persiste en el archivo argumento el estado del directorio. Respetando el formato requerido. */
+/* De manera inversa persiste en el archivo argumento el estado del directorio. Respetando el formato requerido.
+   Un árbol B+ ya escribió sus cambios en disco; si todavía no existe, se escribe un árbol vacío. */
 
 void
 Directory::WriteBack(OpenFile *file)
 {   
     DEBUG('f', "Writing back directory to disk.\n");
+
+    if (tree != nullptr)
+        return;
+    if (format == BTREE_DIRECTORY) {
+        ASSERT(file != nullptr);
+        BTreeDirectory::Format(file);
+        return;
+    }
     
     if(debug.IsEnabled('j')){
         DEBUG('j', "Table state before writing to disk. \n");
@@ -130,6 +154,9 @@ Directory::Find(const char *name)
 {
     ASSERT(name != nullptr);
 
+    if (tree != nullptr)
+        return tree->Find(name);
+
     int i = FindIndex(name);
     if (i != -1)
         return raw.table[i].sector;
@@ -149,6 +176,9 @@ Directory::Add(const char *name, int newSector)
 {
     ASSERT(name != nullptr);
 
+    if (tree != nullptr)
+        return tree->Add(name, newSector);
+
     if (FindIndex(name) != -1)
         return false;
 
@@ -178,6 +208,9 @@ Directory::Remove(const char *name)
 {
     ASSERT(name != nullptr);
 
+    if (tree != nullptr)
+        return tree->Remove(name);
+
     int i = FindIndex(name);
     if (i == -1)
         return false;  // name not in directory
@@ -185,13 +218,75 @@ Directory::Remove(const char *name)
     return true;
 }
 
+/* Para la tabla lineal el cursor es el índice de la próxima entrada a
+   mirar; para el árbol B+ lo interpreta `BTreeDirectory`. */
+unsigned
+Directory::ReadEntries(unsigned *cursor, DirectoryEntry *entries,
+                       unsigned maxEntries) const
+{
+    ASSERT(cursor != nullptr);
+    ASSERT(entries != nullptr);
+
+    if (tree != nullptr) {
+        int count = tree->ReadEntries(cursor, entries, maxEntries);
+        ASSERT(count >= 0);
+        return count;
+    }
+
+    unsigned count = 0;
+    unsigned i = *cursor;
+    for (; i < raw.tableSize && count < maxEntries; i++)
+        if (raw.table[i].inUse)
+            entries[count++] = raw.table[i];
+    *cursor = i;
+    return count;
+}
+
+/* Para la tabla lineal se leen del archivo sólo las entradas a partir del
+   cursor, de a `ENTRY_BATCH`; el árbol B+ ya recorre sus hojas de a una.
+   Un cursor pasado el final de la tabla no es un error: no devuelve nada. */
+int
+Directory::ReadEntriesFrom(OpenFile *file, unsigned *cursor,
+                           DirectoryEntry *entries, unsigned maxEntries)
+{
+    ASSERT(file != nullptr);
+    ASSERT(cursor != nullptr);
+    ASSERT(entries != nullptr);
+
+    if (file->GetHeader()->GetDirectoryFormat() == BTREE_DIRECTORY) {
+        BTreeDirectory tree(file);
+        return tree.ReadEntries(cursor, entries, maxEntries);
+    }
+
+    unsigned tableSize = 0;
+    file->ReadAt((char *) &tableSize, 1, 0);
+
+    DirectoryEntry batch[ENTRY_BATCH];
+    unsigned count = 0;
+    unsigned i = *cursor;
+    while (i < tableSize && count < maxEntries) {
+        unsigned n = tableSize - i < ENTRY_BATCH ? tableSize - i : ENTRY_BATCH;
+        file->ReadAt((char *) batch, n * sizeof (DirectoryEntry),
+                     1 + i * sizeof (DirectoryEntry));
+        unsigned j = 0;
+        for (; j < n && count < maxEntries; j++)
+            if (batch[j].inUse)
+                entries[count++] = batch[j];
+        i += j;
+    }
+    *cursor = i;
+    return (int) count;
+}
+
 /// List all the file names in the directory.
 void
 Directory::List() const
 {
-    for (unsigned i = 0; i < raw.tableSize; i++)
-        if (raw.table[i].inUse)
-            printf("- %s \n", raw.table[i].name);
+    DirectoryEntry entries[ENTRY_BATCH];
+    unsigned cursor = 0, count;
+    while ((count = ReadEntries(&cursor, entries, ENTRY_BATCH)) > 0)
+        for (unsigned i = 0; i < count; i++)
+            printf("- %s \n", entries[i].name);
 }
 
 /// List all the file names in the directory, their `FileHeader` locations,
@@ -202,13 +297,15 @@ Directory::Print() const
     FileHeader *hdr = new FileHeader;
 
     printf("Directory contents:\n");
-    for (unsigned i = 0; i < raw.tableSize; i++)
-        if (raw.table[i].inUse) {
+    DirectoryEntry entries[ENTRY_BATCH];
+    unsigned cursor = 0, count;
+    while ((count = ReadEntries(&cursor, entries, ENTRY_BATCH)) > 0)
+        for (unsigned i = 0; i < count; i++) {
             printf("\nDirectory entry:\n"
                    "    name: %s\n"
                    "    sector: %u\n",
-                   raw.table[i].name, raw.table[i].sector);
-            hdr->FetchFrom(raw.table[i].sector);
+                   entries[i].name, entries[i].sector);
+            hdr->FetchFrom(entries[i].sector);
             hdr->Print(nullptr);
         }
     printf("\n");
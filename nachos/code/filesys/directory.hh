@@ -4,6 +4,10 @@
 /// of each file in the directory, and where to find its file header (the
 /// data structure describing where to find the file's data blocks) on disk.
 ///
+/// A directory may instead be stored as a B+-tree (see
+/// `btree_directory.hh`); in that case operations go straight to the nodes
+/// on disk and nothing is kept in memory.
+///
 /// We assume mutual exclusion is provided by the caller.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
@@ -16,10 +20,13 @@
 
 
 #include "raw_directory.hh"
+#include "directory_entry.hh"
 #include "open_file.hh"
 #include <stdlib.h>
 
 
+class BTreeDirectory;
+
 /// The following class defines a UNIX-like “directory”.  Each entry in the
 /// directory describes a file, and where to find it on disk.
 ///
@@ -28,12 +35,14 @@
 ///
 /// The constructor initializes a directory structure in memory; the
 /// `FetchFrom`/`WriteBack` operations shuffle the directory information
-/// from/to disk.
+/// from/to disk.  For B+-tree directories, `FetchFrom` only attaches the
+/// object to the file, and every modification is written immediately.
 class Directory {
 public:
 
-    /// Initialize an empty directory with space for `size` files.
-    Directory(unsigned size);
+    /// Initialize an empty directory with space for `size` files.  `format`
+    /// is the layout used when writing a new directory to disk.
+    Directory(unsigned size, DirectoryFormat format = LINEAR_DIRECTORY);
 
     /// De-allocate the directory.
     ~Directory();
@@ -53,6 +62,23 @@ public:
     /// Remove a file from the directory.
     bool Remove(const char *name);
 
+    /// Copy up to `maxEntries` entries in use into `entries`, starting at
+    /// the position recorded in `cursor`, and advance it.  A cursor equal
+    /// to 0 starts at the first entry.  Return the number of entries copied.
+    unsigned ReadEntries(unsigned *cursor, DirectoryEntry *entries,
+                         unsigned maxEntries) const;
+
+    /// Number of entries fetched at a time when walking a directory with
+    /// `ReadEntries`.
+    static const unsigned ENTRY_BATCH = 8;
+
+    /// Same as `ReadEntries`, but reading the entries straight from the
+    /// directory stored in `file`, without fetching the whole directory.
+    /// Only the sectors holding the entries returned are read.  The cursor
+    /// may come from a user program, so a bad one makes it return -1.
+    static int ReadEntriesFrom(OpenFile *file, unsigned *cursor,
+                               DirectoryEntry *entries, unsigned maxEntries);
+
     /// Print the names of all the files in the directory.
     void List() const;
 
@@ -71,6 +97,11 @@ private:
     int FindIndex(const char *name);
 
     RawDirectory raw;
+
+    DirectoryFormat format;
+
+    /// Tree attached by `FetchFrom`, if the directory is a B+-tree.
+    BTreeDirectory *tree;
 };
 
 
@@ -10,6 +10,13 @@
 /// For simplicity, we assume file names are <= 9 characters long.
 const unsigned FILE_NAME_MAX_LEN = 9;
 
+/// On-disk layouts a directory file can have.  The format is chosen when
+/// the disk is formatted and recorded in each directory's file header.
+enum DirectoryFormat {
+    LINEAR_DIRECTORY = 0,  ///< A table of entries, read and written whole.
+    BTREE_DIRECTORY  = 1   ///< A B+-tree of one-sector nodes.
+};
+
 /// The following class defines a "directory entry", representing a file in
 /// the directory.  Each entry gives the name of the file, and where the
 /// file's header is to be found on disk.
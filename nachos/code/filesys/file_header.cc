@@ -248,6 +248,7 @@ FileHeader::FileExpand(unsigned sizeToExpand, unsigned sector){
 
     OpenFile* freeMapFile = new OpenFile(0);
     Bitmap *freeMap = new Bitmap(NUM_SECTORS);
+    freeMapLock->Acquire();
     freeMap->FetchFrom(freeMapFile);
 
     bool success = Allocate(freeMap, sizeToExpand + raw.numBytes, raw.numSectors);
@@ -255,12 +256,95 @@ FileHeader::FileExpand(unsigned sizeToExpand, unsigned sector){
         freeMap->WriteBack(freeMapFile);
         WriteBack(sector);
     }
+    freeMapLock->Release();
 
     delete freeMapFile;
+    delete freeMap;
 
     return success;
 }
 
+unsigned
+FileHeader::SectorsOnDisk() const
+{
+    unsigned n = raw.numSectors;
+    unsigned total = n;
+    if (n > NUM_DIRECT)
+        total++;
+    if (n > NUM_DIRECT + NUM_INDIRECT)
+        total += 1 + DivRoundUp(n - NUM_DIRECT - NUM_INDIRECT, NUM_INDIRECT);
+    return total;
+}
+
+/* Recorre los bloques igual que `Allocate`: directos, primera indirección
+   y segunda indirección, poniendo cada bloque de índices antes de los
+   bloques de datos a los que apunta. */
+void
+FileHeader::ListSectors(unsigned *sectors)
+{
+    ASSERT(sectors != nullptr);
+
+    unsigned n = raw.numSectors;
+    unsigned count = 0, i = 0;
+
+    for ( ; i < NUM_DIRECT && i < n; i++)
+        sectors[count++] = raw.dataSectors[i];
+
+    if (n > NUM_DIRECT) {
+        IndirectRawFileHeader indirect;
+        synchDisk->ReadSector(raw.dataSectors[FIRST_INDIRECTION], (char *) &indirect);
+        sectors[count++] = raw.dataSectors[FIRST_INDIRECTION];
+        for ( ; i < NUM_DIRECT + NUM_INDIRECT && i < n; i++)
+            sectors[count++] = indirect.dataSectors[i - NUM_DIRECT];
+    }
+
+    if (n > NUM_DIRECT + NUM_INDIRECT) {
+        IndirectRawFileHeader blocks, indirect;
+        synchDisk->ReadSector(raw.dataSectors[SECOND_INDIRECTION], (char *) &blocks);
+        sectors[count++] = raw.dataSectors[SECOND_INDIRECTION];
+        for (unsigned k = 0; i < n; k++) {
+            synchDisk->ReadSector(blocks.dataSectors[k], (char *) &indirect);
+            sectors[count++] = blocks.dataSectors[k];
+            for (unsigned j = 0; j < NUM_INDIRECT && i < n; j++, i++)
+                sectors[count++] = indirect.dataSectors[j];
+        }
+    }
+
+    ASSERT(count == SectorsOnDisk());
+}
+
+/* Inversa de `ListSectors`: asigna los sectores consecutivos en el mismo
+   orden y escribe los nuevos bloques de índices. */
+void
+FileHeader::Relocate(unsigned firstSector)
+{
+    unsigned n = raw.numSectors;
+    unsigned next = firstSector, i = 0;
+
+    for ( ; i < NUM_DIRECT && i < n; i++)
+        raw.dataSectors[i] = next++;
+
+    if (n > NUM_DIRECT) {
+        IndirectRawFileHeader indirect;
+        raw.dataSectors[FIRST_INDIRECTION] = next++;
+        for ( ; i < NUM_DIRECT + NUM_INDIRECT && i < n; i++)
+            indirect.dataSectors[i - NUM_DIRECT] = next++;
+        synchDisk->WriteSector(raw.dataSectors[FIRST_INDIRECTION], (char *) &indirect);
+    }
+
+    if (n > NUM_DIRECT + NUM_INDIRECT) {
+        IndirectRawFileHeader blocks, indirect;
+        raw.dataSectors[SECOND_INDIRECTION] = next++;
+        for (unsigned k = 0; i < n; k++) {
+            blocks.dataSectors[k] = next++;
+            for (unsigned j = 0; j < NUM_INDIRECT && i < n; j++, i++)
+                indirect.dataSectors[j] = next++;
+            synchDisk->WriteSector(blocks.dataSectors[k], (char *) &indirect);
+        }
+        synchDisk->WriteSector(raw.dataSectors[SECOND_INDIRECTION], (char *) &blocks);
+    }
+}
+
 /// Print the contents of the file header, and the contents of all the data
 /// blocks pointed to by the file header.
 void
@@ -309,6 +393,21 @@ FileHeader::SetIsDirectory(bool isDirectory){
 }
 
 bool
-FileHeader::IsDirectory(){
+FileHeader::IsDirectory() const {
     return raw.isDirectory;
+}
+
+void
+FileHeader::SetDirectoryFormat(DirectoryFormat format){
+    raw.directoryFormat = format;
+}
+
+/* Los discos formateados antes de que existiera el campo pueden tener
+   basura en él, por eso sólo se tiene en cuenta si es un directorio y
+   el valor es conocido. */
+DirectoryFormat
+FileHeader::GetDirectoryFormat() const {
+    if (raw.isDirectory && raw.directoryFormat == BTREE_DIRECTORY)
+        return BTREE_DIRECTORY;
+    return LINEAR_DIRECTORY;
 }
\ No newline at end of file
@@ -14,6 +14,7 @@
 
 
 #include "raw_file_header.hh"
+#include "directory_entry.hh"
 #include "lib/bitmap.hh"
 
 
@@ -59,9 +60,29 @@ public:
 
     void SetIsDirectory(bool isDirectory);
 
-    bool IsDirectory();
+    bool IsDirectory() const;
+
+    /// Layout of the directory stored in this file.
+    void SetDirectoryFormat(DirectoryFormat format);
+
+    DirectoryFormat GetDirectoryFormat() const;
 
     bool FileExpand(unsigned sizeToExpand, unsigned sector);
+
+    /// Number of disk sectors used by the file, counting index blocks.
+    unsigned SectorsOnDisk() const;
+
+    /// Store in `sectors` every disk sector used by the file, in the order
+    /// a sequential reader visits them: each index block comes right before
+    /// the data blocks it points to.  `sectors` must have room for
+    /// `SectorsOnDisk()` entries.
+    void ListSectors(unsigned *sectors);
+
+    /// Point the file at the `SectorsOnDisk()` consecutive sectors starting
+    /// at `firstSector`, laid out in the order of `ListSectors`, and write
+    /// the new index blocks.  The data must already be in place; the header
+    /// itself is not written back.
+    void Relocate(unsigned firstSector);
     /// Get the raw file header structure.
     ///
     /// NOTE: this should only be used by routines that operate on the file
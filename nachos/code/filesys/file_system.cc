@@ -47,9 +47,11 @@
 #include "directory_entry.hh"
 #include "file_header.hh"
 #include "lib/bitmap.hh"
+#include "lib/list.hh"
 #include "machine/disk.hh"
 #include "threads/system.hh"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 int FindByPath(Path *path, OpenFile *dirFile);
@@ -77,12 +79,13 @@ static const unsigned DIRECTORY_FILE_SIZE = sizeof (DirectoryEntry)
 /// bitmap and the directory.
 ///
 /// * `format` -- should we initialize the disk?
-FileSystem::FileSystem(bool format)
+/// * `dirFormat` -- layout of the directories on a newly formatted disk.
+FileSystem::FileSystem(bool format, DirectoryFormat dirFormat)
 {
     DEBUG('f', "Initializing the file system.\n");
     if (format) {
         Bitmap     *freeMap = new Bitmap(NUM_SECTORS);
-        Directory  *dir     = new Directory(NUM_DIR_ENTRIES);
+        Directory  *dir     = new Directory(NUM_DIR_ENTRIES, dirFormat);
         FileHeader *mapH    = new FileHeader;
         FileHeader *dirH    = new FileHeader;
 
@@ -98,6 +101,10 @@ FileSystem::FileSystem(bool format)
 
         ASSERT(mapH->Allocate(freeMap, FREE_MAP_FILE_SIZE));
         ASSERT(dirH->Allocate(freeMap, DIRECTORY_FILE_SIZE));
+        mapH->SetIsDirectory(false);
+        dirH->SetIsDirectory(true);
+        dirH->SetDirectoryFormat(dirFormat);
+        directoryFormat = dirFormat;
 
         // Flush the bitmap and directory `FileHeader`s back to disk.
         // We need to do this before we can `Open` the file, since open reads
@@ -143,6 +150,7 @@ FileSystem::FileSystem(bool format)
         // Nachos is running.
         freeMapFile   = new OpenFile(FREE_MAP_SECTOR, "FreeMap");
         directoryFile = new OpenFile(DIRECTORY_SECTOR, "Directory");
+        directoryFormat = directoryFile->GetHeader()->GetDirectoryFormat();
     }
 }
 
@@ -160,9 +168,12 @@ FileSystem::~FileSystem()
 /// 1. Make sure the file does not already exist.
 /// 2. Allocate a sector for the file header.
 /// 3. Allocate space on disk for the data blocks for the file.
-/// 4. Add the name to the directory.
-/// 5. Store the new file header on disk.
-/// 6. Flush the changes to the bitmap and the directory back to disk.
+/// 4. Flush the bitmap and store the new file header on disk.
+/// 5. Add the name to the directory.
+/// 6. Flush the changes to the directory back to disk.
+///
+/// Every write is done inside a metadata transaction, so the sectors only
+/// reach the disk when the operation finishes, each once and in order.
 ///
 /// Return true if everything goes ok, otherwise, return false.
 ///
@@ -203,37 +214,57 @@ FileSystem::Create(const char *name, unsigned initialSize, bool isDirectory)
         dir->FetchFrom(dirTempFile);    
     #endif
     
+    // Los sectores modificados se escriben todos juntos al final.
+    synchDisk->BeginTransaction();
+
     bool success;
     if (dir->Find(name) != -1)
         success = false;  // File is already in directory.
     else {
         Bitmap *freeMap = new Bitmap(NUM_SECTORS);
+        freeMapLock->Acquire();
         freeMap->FetchFrom(freeMapFile);
         int sector = freeMap->Find();
           // Find a sector to hold the file header.
-        if (sector == -1)
+        if (sector == -1) {
             success = false;  // No free block for file header.
-        else if (!dir->Add(name, sector))
-            success = false;  // No space in directory.
-        else {
+            freeMapLock->Release();
+        } else {
             
             FileHeader *h = new FileHeader;
             h->SetIsDirectory(isDirectory);
+            h->SetDirectoryFormat(directoryFormat);
             success = h->Allocate(freeMap, initialSize);
             DEBUG('f', "Result of file allocation %s \n", success ? "true" : "false");
 
               // Fails if no space on disk for data.
             if (success) {
-                // Everything worked, flush all changes back to disk.
-                h->WriteBack(sector);
-                dir->WriteBack(dirTempFile);
+                // El bitmap se escribe antes de tocar el directorio: si el
+                // directorio crece, toma sus bloques del bitmap en disco.
                 freeMap->WriteBack(freeMapFile);
-                if (isDirectory) {
-                    Directory* newDirectory = new Directory(NUM_DIR_ENTRIES);
-                    OpenFile* newDirectoryFile = new OpenFile(sector, "TempNewDirectory");
-                    newDirectory->WriteBack(newDirectoryFile);
-                    // delete newDirectory;
-                    delete newDirectoryFile;
+                h->WriteBack(sector);
+            }
+            freeMapLock->Release();
+
+            if (success) {
+                if (!dir->Add(name, sector)) {
+                    success = false;  // No space in directory.
+                    freeMapLock->Acquire();
+                    freeMap->FetchFrom(freeMapFile);
+                    h->Deallocate(freeMap);
+                    freeMap->Clear(sector);
+                    freeMap->WriteBack(freeMapFile);
+                    freeMapLock->Release();
+                } else {
+                    // Everything worked, flush all changes back to disk.
+                    dir->WriteBack(dirTempFile);
+                    if (isDirectory) {
+                        Directory* newDirectory = new Directory(NUM_DIR_ENTRIES, directoryFormat);
+                        OpenFile* newDirectoryFile = new OpenFile(sector, "TempNewDirectory");
+                        newDirectory->WriteBack(newDirectoryFile);
+                        // delete newDirectory;
+                        delete newDirectoryFile;
+                    }
                 }
             }
             delete h;
@@ -241,6 +272,8 @@ FileSystem::Create(const char *name, unsigned initialSize, bool isDirectory)
         delete freeMap;
     }
 
+    synchDisk->CommitTransaction();
+
     #ifdef DIRECTORY
     if(oldDirSector != -1){
         currentThread->SetDirSector(oldDirSector);
@@ -283,18 +316,30 @@ FileSystem::Open(const char *name)
     }
         dirTempFile = new OpenFile(currentThread->GetDirSector(), "DirectoryTempFile");
         dir->FetchFrom(dirTempFile);    
+        // El borrado diferido usa el nombre del enlace, así que se guarda
+        // el camino completo y no sólo el último componente.
+        char *linkName = new char [strlen(name) + 1];
+        strcpy(linkName, name);
         name = path->GetFileName();
     #else
         dir->FetchFrom(dirTempFile);    
+        const char *linkName = name;
     #endif
 
+    #ifdef DIRECTORY
+    // Si el camino termina en un directorio ("/" o "."), se abre ese mismo
+    // directorio.
+    int sector = name == nullptr || strcmp(name, ".") == 0
+                 ? (int) currentThread->GetDirSector() : dir->Find(name);
+    #else
     int sector = dir->Find(name);
-    DEBUG('f', "File with name %s first sector is located at: %d\n", name, sector);
+    #endif
+    DEBUG('f', "File with name %s first sector is located at: %d\n", linkName, sector);
     if (sector >= 0){
         // Validamos si se puede abrir el archivo
         FileTableEntry* file = files->FindBySector(sector);
         if(!file || !file->deleted){
-            openFile = new OpenFile(sector, name);  // `name` was found in directory.
+            openFile = new OpenFile(sector, linkName);  // `name` was found in directory.
         } else{
             DEBUG('f', "Removed file can't be opened. %s\n", name);
         }
@@ -305,6 +350,9 @@ FileSystem::Open(const char *name)
         currentThread->SetDirSector(oldDirSector);
         delete dirTempFile;
     }
+    // Si el archivo ya estaba abierto, la entrada conserva su nombre.
+    if(!openFile || files->FindBySector(sector)->name != linkName)
+        delete [] linkName;
     #endif
     delete dir;
     return openFile;  // Return null if not found.
@@ -318,6 +366,9 @@ FileSystem::Open(const char *name)
 /// 3. Delete the space for its data blocks.
 /// 4. Write changes to directory, bitmap back to disk.
 ///
+/// As in `Create`, the writes are batched in a metadata transaction.  When
+/// removing a directory, the whole subtree goes in that same transaction.
+///
 /// Return true if the file was deleted, false if the file was not in the
 /// file system.
 ///
@@ -353,10 +404,18 @@ FileSystem::Remove(const char *name)
 
     int sector = dir->Find(name);
     if (sector == -1) {
+       #ifdef DIRECTORY
+       currentThread->SetDirSector(oldDirSector);
+       delete dirTempFile;
+       #endif
        delete dir;
        return false;  // file not found
     }
 
+    // Al borrar un directorio, las llamadas recursivas abren transacciones
+    // anidadas: todo se escribe una sola vez, al terminar esta.
+    synchDisk->BeginTransaction();
+
     FileTableEntry* fileEntry = files->FindBySector(sector);
     if(!fileEntry || !fileEntry->open){
         FileHeader *fileH = new FileHeader;
@@ -367,28 +426,43 @@ FileSystem::Remove(const char *name)
                 Directory *tempDir = new Directory(NUM_DIR_ENTRIES);
                 tempDir->FetchFrom(tempDirFile);
 
-                const RawDirectory *rawDir = tempDir->GetRaw();
-                
-                for(int i=0; i < rawDir->tableSize; i++){
-                    if(rawDir->table[i].inUse){
-                        char* temp = path->AppendToRaw(rawDir->table[i].name);
-                        Remove(temp);
-                    }
+                // Se juntan primero los nombres: borrar mientras se recorre
+                // un árbol B+ mueve las entradas de lugar.
+                ::List<char*> children;
+                DirectoryEntry entries[Directory::ENTRY_BATCH];
+                unsigned cursor = 0, count;
+                while ((count = tempDir->ReadEntries(
+                            &cursor, entries, Directory::ENTRY_BATCH)) > 0)
+                    for (unsigned i = 0; i < count; i++)
+                        children.Append(path->AppendToRaw(entries[i].name));
+                while (!children.IsEmpty()){
+                    char* temp = children.Pop();
+                    Remove(temp);
+                    free(temp);
                 }
                 tempDir->WriteBack(tempDirFile);
-                // delete tempDir;
+                delete tempDir;
+                // Cerrarlo antes de liberar el sector: si no, el enlace
+                // queda en la tabla y lo hereda el próximo archivo creado
+                // en ese sector.
+                delete tempDirFile;
            
         }
         #endif
 
         Bitmap *freeMap = new Bitmap(NUM_SECTORS);
+        freeMapLock->Acquire();
         freeMap->FetchFrom(freeMapFile);
 
+        // El desfragmentador puede haber movido el archivo desde que se
+        // leyó el encabezado.
+        fileH->FetchFrom(sector);
         fileH->Deallocate(freeMap);  // Remove data blocks.
         freeMap->Clear(sector);      // Remove header block.
-        dir->Remove(name);
-    
         freeMap->WriteBack(freeMapFile);  // Flush to disk.
+        freeMapLock->Release();
+
+        dir->Remove(name);
         #ifdef DIRECTORY
         dir->WriteBack(dirTempFile);    // Flush to disk.
         #else
@@ -403,6 +477,8 @@ FileSystem::Remove(const char *name)
         fileEntry->deleted = true;
     }
 
+    synchDisk->CommitTransaction();
+
     #ifdef DIRECTORY
     if(oldDirSector != -1){
         currentThread->SetDirSector(oldDirSector);
@@ -520,20 +596,23 @@ CheckBitmaps(const Bitmap *freeMap, const Bitmap *shadowMap)
 }
 
 static bool
-CheckDirectory(const RawDirectory *rd, Bitmap *shadowMap)
+CheckDirectory(const Directory *dir, Bitmap *shadowMap)
 {
-    ASSERT(rd != nullptr);
+    ASSERT(dir != nullptr);
     ASSERT(shadowMap != nullptr);
 
     bool error = false;
     unsigned nameCount = 0;
-    const char *knownNames[NUM_DIR_ENTRIES];
+    char (*knownNames)[FILE_NAME_MAX_LEN + 1] = nullptr;
 
-    for (unsigned i = 0; i < NUM_DIR_ENTRIES; i++) {
-        DEBUG('f', "Checking direntry: %u.\n", i);
-        const DirectoryEntry *e = &rd->table[i];
+    DirectoryEntry entries[Directory::ENTRY_BATCH];
+    unsigned cursor = 0, count, seen = 0;
+    while ((count = dir->ReadEntries(&cursor, entries,
+                                     Directory::ENTRY_BATCH)) > 0) {
+        for (unsigned i = 0; i < count; i++, seen++) {
+            DEBUG('f', "Checking direntry: %u.\n", seen);
+            const DirectoryEntry *e = &entries[i];
 
-        if (e->inUse) {
             if (strlen(e->name) > FILE_NAME_MAX_LEN) {
                 DEBUG('f', "Filename too long.\n");
                 error = true;
@@ -553,7 +632,9 @@ CheckDirectory(const RawDirectory *rd, Bitmap *shadowMap)
                 }
             }
             if (!repeated) {
-                knownNames[nameCount] = e->name;
+                knownNames = (char (*)[FILE_NAME_MAX_LEN + 1])
+                  realloc(knownNames, (nameCount + 1) * sizeof *knownNames);
+                strncpy(knownNames[nameCount], e->name, FILE_NAME_MAX_LEN + 1);
                 DEBUG('f', "Added \"%s\" at %u.\n", e->name, nameCount);
                 nameCount++;
             }
@@ -569,6 +650,7 @@ CheckDirectory(const RawDirectory *rd, Bitmap *shadowMap)
             delete h;
         }
     }
+    free(knownNames);
     return error;
 }
 
@@ -609,9 +691,8 @@ FileSystem::Check()
     Bitmap *freeMap = new Bitmap(NUM_SECTORS);
     freeMap->FetchFrom(freeMapFile);
     Directory *dir = new Directory(NUM_DIR_ENTRIES);
-    const RawDirectory *rdir = dir->GetRaw();
     dir->FetchFrom(directoryFile);
-    error |= CheckDirectory(rdir, shadowMap);
+    error |= CheckDirectory(dir, shadowMap);
     delete dir;
 
     // The two bitmaps should match.
@@ -709,28 +790,34 @@ FindByPath(Path *path, OpenFile *dirFile){
     List<char*> dirPath = path->GetPath();
 
     if(!path->IsRelative()){
-        if(path->Length() == 1) 
+        if(path->Length() == 1) {
+            delete tempDir;
             return 1;
-        else
+        } else
             dirPath.Pop();
     }
     
+    // Un directorio árbol B+ lee sus nodos del archivo en cada búsqueda,
+    // así que el archivo se cierra recién después de pasar al siguiente.
+    OpenFile *tempDirFile = nullptr;
     while(!dirPath.IsEmpty()){
         
         sector = tempDir->Find(dirPath.Pop());
 
         // Invalid path.
         if(sector == -1){
-            return -1;
+            break;
         }
         
-        OpenFile *tempDirFile = new OpenFile(sector, "TempDirFile1");
-        tempDir->FetchFrom(tempDirFile);
-        if (tempDirFile) delete tempDirFile;
+        OpenFile *nextDirFile = new OpenFile(sector, "TempDirFile1");
+        tempDir->FetchFrom(nextDirFile);
+        delete tempDirFile;
+        tempDirFile = nextDirFile;
 
     }
     
-
+    delete tempDir;
+    delete tempDirFile;
     return sector;
 }
 
@@ -80,6 +80,8 @@ public:
 };
 
 #else  // FILESYS
+#include "directory_entry.hh"
+
 class FileSystem {
 public:
 
@@ -87,8 +89,10 @@ public:
     /// been initialized.
     ///
     /// If `format`, there is nothing on the disk, so initialize the
-    /// directory and the bitmap of free blocks.
-    FileSystem(bool format);
+    /// directory and the bitmap of free blocks.  `dirFormat` selects the
+    /// layout of every directory created on the new disk; otherwise it is
+    /// read from the root directory.
+    FileSystem(bool format, DirectoryFormat dirFormat = LINEAR_DIRECTORY);
 
     ~FileSystem();
 
@@ -121,6 +125,7 @@ private:
                             ///< file.
     OpenFile *directoryFile;  ///< “Root” directory -- list of file names,
                               ///< represented as a file.
+    DirectoryFormat directoryFormat;  ///< Layout of new directories.
 };
 
 #endif
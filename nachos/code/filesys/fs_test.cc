@@ -17,6 +17,12 @@
 
 
 #include "file_system.hh"
+#include "btree_directory.hh"
+#include "defragmenter.hh"
+#include "directory.hh"
+#include "file_header.hh"
+#include "metadata_transaction.hh"
+#include "synch_disk.hh"
 #include "lib/utility.hh"
 #include "machine/disk.hh"
 #include "machine/statistics.hh"
@@ -202,6 +208,430 @@ Reader(void *args){
 }
 #endif
 
+#ifdef DIRECTORY
+/// Directory tests
+///
+/// Check the directory formats on small cases whose outcome is known in
+/// advance, printing whether each one passed:
+/// * `BTreeTest` -- insertion with splits, and lazy removal, straight on a
+///   B+-tree stored in a plain file.
+/// * `CursorTest` -- listing a directory with `ReadEntries` a few entries at
+///   a time, after some of its files were removed.
+
+/// Names inserted by `BTreeTest`: enough to split leaves, and then the root
+/// once it is an internal node.
+static const unsigned BTREE_TEST_NAMES = 100;
+
+static void
+BTreeTestName(char *name, unsigned i)
+{
+    snprintf(name, FILE_NAME_MAX_LEN + 1, "n%03u", i);
+}
+
+/// Check that `tree` holds the name of every `i` below `BTREE_TEST_NAMES`,
+/// or only those of the multiples of 3 if `onlyThirds`, with `i` as their
+/// sector.  Names are looked up one by one, and then listed following the
+/// cursor, three at a time, which must give them in increasing order.
+static bool
+BTreeTestCheck(BTreeDirectory *tree, bool onlyThirds)
+{
+    char name[FILE_NAME_MAX_LEN + 1];
+    for (unsigned i = 0; i < BTREE_TEST_NAMES; i++) {
+        BTreeTestName(name, i);
+        int expected = !onlyThirds || i % 3 == 0 ? (int) i : -1;
+        if (tree->Find(name) != expected)
+            return false;
+    }
+
+    DirectoryEntry entries[3];
+    unsigned cursor = 0, next = 0;
+    int count;
+    while ((count = tree->ReadEntries(&cursor, entries, 3)) > 0)
+        for (int j = 0; j < count; j++) {
+            while (onlyThirds && next % 3 != 0)
+                next++;
+            BTreeTestName(name, next);
+            if (strcmp(entries[j].name, name) != 0
+                  || entries[j].sector != next)
+                return false;
+            next++;
+        }
+    return count == 0 && next == BTREE_TEST_NAMES;
+}
+
+/* Los nombres se insertan desordenados, para partir hojas por el medio y no
+   sólo por el final.  Después se borran dos de cada tres y se vuelven a
+   insertar: como las hojas vaciadas se reutilizan, el archivo no crece. */
+static bool
+BTreeTest()
+{
+    printf("Starting B+-tree directory test:\n");
+    if (!fileSystem->Create("/btree", 0)) {
+        printf("Create failed.\n");
+        return false;
+    }
+    OpenFile *file = fileSystem->Open("/btree");
+    BTreeDirectory::Format(file);
+    BTreeDirectory *tree = new BTreeDirectory(file);
+
+    char name[FILE_NAME_MAX_LEN + 1];
+    bool ok = true;
+    for (unsigned k = 0; k < BTREE_TEST_NAMES; k++) {
+        unsigned i = k * 37 % BTREE_TEST_NAMES;
+        BTreeTestName(name, i);
+        ok = tree->Add(name, i) && ok;
+    }
+    BTreeTestName(name, 0);
+    ok = ok && !tree->Add(name, 0);  // Already there.
+    ok = ok && BTreeTestCheck(tree, false);
+    printf("Inserted %u names: %s.\n", BTREE_TEST_NAMES, ok ? "ok" : "failed");
+
+    for (unsigned i = 0; i < BTREE_TEST_NAMES; i++)
+        if (i % 3 != 0) {
+            BTreeTestName(name, i);
+            ok = tree->Remove(name) && ok;
+        }
+    BTreeTestName(name, 1);
+    ok = ok && !tree->Remove(name);  // Already removed.
+    ok = ok && BTreeTestCheck(tree, true);
+    printf("Removed two thirds: %s.\n", ok ? "ok" : "failed");
+
+    unsigned length = file->Length();
+    for (unsigned i = 0; i < BTREE_TEST_NAMES; i++)
+        if (i % 3 != 0) {
+            BTreeTestName(name, i);
+            ok = tree->Add(name, i) && ok;
+        }
+    ok = ok && BTreeTestCheck(tree, false) && file->Length() == length;
+    printf("Inserted them again in the emptied leaves: %s.\n",
+           ok ? "ok" : "failed");
+
+    DirectoryEntry entry;
+    unsigned cursor = 5;  // Block 0 is the header, not a leaf.
+    ok = ok && tree->ReadEntries(&cursor, &entry, 1) == -1;
+
+    delete tree;
+    delete file;
+    ok = fileSystem->Remove("/btree") && ok;
+    printf("B+-tree directory test %s.\n", ok ? "passed" : "failed");
+    return ok;
+}
+
+/// Number of files created by `CursorTest`, and which of them it removes.
+static const unsigned CURSOR_TEST_FILES = 10;
+static const unsigned CURSOR_TEST_REMOVED[] = { 2, 3, 7 };
+
+/// Count in `seen` the files of `CursorTest` found among `entries`.
+static void
+CursorTestCount(const DirectoryEntry *entries, unsigned count, unsigned *seen)
+{
+    for (unsigned j = 0; j < count; j++) {
+        unsigned i;
+        if (sscanf(entries[j].name, "f%u", &i) == 1 && i < CURSOR_TEST_FILES)
+            seen[i]++;
+    }
+}
+
+/// Check that every file of `CursorTest` was seen once, except the removed
+/// ones, which must not be seen at all.
+static bool
+CursorTestCheck(const unsigned *seen)
+{
+    for (unsigned i = 0; i < CURSOR_TEST_FILES; i++) {
+        unsigned expected = 1;
+        for (unsigned r : CURSOR_TEST_REMOVED)
+            if (r == i)
+                expected = 0;
+        if (seen[i] != expected)
+            return false;
+    }
+    return true;
+}
+
+/* El directorio se lista de a dos entradas, así el cursor tiene que
+   retomar cada vez donde quedó, también saltando los huecos que dejan los
+   archivos borrados.  Se recorre tanto leyendo del archivo como con el
+   directorio traído a memoria; sirve para cualquiera de los dos formatos. */
+static bool
+CursorTest()
+{
+    printf("Starting directory cursor test:\n");
+    if (!fileSystem->Create("/cursor", 0, true)) {
+        printf("Create failed.\n");
+        return false;
+    }
+    char path[32];
+    bool ok = true;
+    for (unsigned i = 0; i < CURSOR_TEST_FILES; i++) {
+        snprintf(path, sizeof path, "/cursor/f%u", i);
+        ok = fileSystem->Create(path, 0) && ok;
+    }
+    for (unsigned i : CURSOR_TEST_REMOVED) {
+        snprintf(path, sizeof path, "/cursor/f%u", i);
+        ok = fileSystem->Remove(path) && ok;
+    }
+
+    OpenFile *file = fileSystem->Open("/cursor");
+    DirectoryEntry entries[2];
+    unsigned seen[CURSOR_TEST_FILES] = { 0 };
+    unsigned cursor = 0;
+    int count;
+    while ((count = Directory::ReadEntriesFrom(file, &cursor, entries, 2)) > 0)
+        CursorTestCount(entries, count, seen);
+    ok = ok && count == 0 && CursorTestCheck(seen);
+    printf("Listed from the file: %s.\n", ok ? "ok" : "failed");
+
+    Directory *dir = new Directory(1);
+    dir->FetchFrom(file);
+    memset(seen, 0, sizeof seen);
+    cursor = 0;
+    unsigned n;
+    while ((n = dir->ReadEntries(&cursor, entries, 2)) > 0)
+        CursorTestCount(entries, n, seen);
+    ok = ok && CursorTestCheck(seen);
+    printf("Listed from memory: %s.\n", ok ? "ok" : "failed");
+
+    delete dir;
+    delete file;
+    ok = fileSystem->Remove("/cursor") && ok;
+    printf("Directory cursor test %s.\n", ok ? "passed" : "failed");
+    return ok;
+}
+
+/// Transaction tests
+///
+/// * `TransactionOrderTest` -- the sectors kept by a transaction, and the
+///   writes of threads that do not own it, on `MetadataTransaction` alone.
+/// * `TransactionDiskTest` -- when `SynchDisk` actually writes: at the
+///   outermost commit, as soon as `TRANSACTION_MAX_SECTORS` are kept, and
+///   right away for other threads.
+///
+/// The disk test rewrites the last sectors of the disk with the contents
+/// they already have, so the file system is left as it was.
+
+static void
+FillSector(char *data, char c)
+{
+    memset(data, c, SECTOR_SIZE);
+}
+
+/* Los sectores se escriben desordenados y tienen que salir en orden
+   creciente.  Otro hilo no puede abrir una transacción mientras ésta esté
+   abierta, y sus escrituras no se guardan, salvo que caigan en un sector ya
+   guardado: entonces actualizan la copia. */
+static bool
+TransactionOrderTest()
+{
+    printf("Starting transaction order test:\n");
+    MetadataTransaction *transaction = new MetadataTransaction;
+    Thread *other = new Thread("other");
+    char *data = new char [SECTOR_SIZE];
+    bool ok = true;
+
+    ok = ok && transaction->Begin(currentThread);
+    static const unsigned SECTORS[] = { 40, 7, 23, 12 };
+    for (unsigned sector : SECTORS) {
+        FillSector(data, (char) sector);
+        ok = ok && transaction->Write(sector, data, currentThread);
+    }
+    ok = ok && transaction->Begin(currentThread)
+            && !transaction->Commit(currentThread);  // Nested.
+    ok = ok && !transaction->Begin(other);
+
+    FillSector(data, 'z');
+    ok = ok && !transaction->Write(50, data, other)   // Written through.
+            && !transaction->Write(23, data, other);  // Also updates it.
+    ok = ok && !transaction->Read(50, data) && transaction->Read(23, data)
+            && data[0] == 'z';
+    ok = ok && !transaction->IsFull();
+    ok = ok && transaction->Commit(currentThread);
+    printf("Kept the owner's sectors only: %s.\n", ok ? "ok" : "failed");
+
+    static const unsigned ORDER[] = { 7, 12, 23, 40 };
+    unsigned sector;
+    for (unsigned expected : ORDER) {
+        ok = ok && transaction->PopFirst(&sector, data) && sector == expected
+                && data[0] == (expected == 23 ? 'z' : (char) expected);
+    }
+    ok = ok && !transaction->PopFirst(&sector, data);
+    printf("Flushed in increasing order: %s.\n", ok ? "ok" : "failed");
+
+    delete [] data;
+    delete other;
+    delete transaction;
+    printf("Transaction order test %s.\n", ok ? "passed" : "failed");
+    return ok;
+}
+
+/// Sectors used by `TransactionDiskTest`, at the end of the disk.
+static const unsigned TRANSACTION_TEST_SECTORS = TRANSACTION_MAX_SECTORS + 4;
+static const unsigned TRANSACTION_TEST_FIRST
+  = NUM_SECTORS - TRANSACTION_TEST_SECTORS;
+
+/// Contents of the sectors used by `TransactionDiskTest`.
+static char *transactionTestData;
+
+/// Whether the thread forked by `TransactionDiskTest` got its transaction.
+static bool transactionTestBegun;
+
+/// Rewrite the last test sector outside of any transaction.
+static void
+TransactionTestWriter(void *)
+{
+    unsigned i = TRANSACTION_TEST_SECTORS - 1;
+    synchDisk->WriteSector(TRANSACTION_TEST_FIRST + i,
+                           &transactionTestData[i * SECTOR_SIZE]);
+}
+
+/// Open a transaction, which has to wait for the one of the main thread.
+static void
+TransactionTestOpener(void *)
+{
+    synchDisk->BeginTransaction();
+    transactionTestBegun = true;
+    synchDisk->CommitTransaction();
+}
+
+/* Cuenta las escrituras que llegan al disco en cada paso.  El hilo que
+   escribe sin transacción tiene que llegar al disco enseguida, y el que
+   quiere abrir una tiene que esperar hasta el final de la nuestra. */
+static bool
+TransactionDiskTest()
+{
+    printf("Starting transaction disk test:\n");
+    transactionTestData = new char [TRANSACTION_TEST_SECTORS * SECTOR_SIZE];
+    for (unsigned i = 0; i < TRANSACTION_TEST_SECTORS; i++)
+        synchDisk->ReadSector(TRANSACTION_TEST_FIRST + i,
+                              &transactionTestData[i * SECTOR_SIZE]);
+    bool ok = true;
+
+    synchDisk->BeginTransaction();
+    unsigned long writes = stats->numDiskWrites;
+    for (unsigned i = 0; i < TRANSACTION_MAX_SECTORS - 1; i++)
+        synchDisk->WriteSector(TRANSACTION_TEST_FIRST + i,
+                               &transactionTestData[i * SECTOR_SIZE]);
+    ok = ok && stats->numDiskWrites == writes;
+    unsigned i = TRANSACTION_MAX_SECTORS - 1;
+    synchDisk->WriteSector(TRANSACTION_TEST_FIRST + i,
+                           &transactionTestData[i * SECTOR_SIZE]);
+    ok = ok && stats->numDiskWrites == writes + TRANSACTION_MAX_SECTORS;
+    printf("Flushed early at %u sectors: %s.\n", TRANSACTION_MAX_SECTORS,
+           ok ? "ok" : "failed");
+
+    writes = stats->numDiskWrites;
+    synchDisk->WriteSector(TRANSACTION_TEST_FIRST,
+                           &transactionTestData[0]);
+    Thread *writer = new Thread("transaction writer", true);
+    writer->Fork(TransactionTestWriter, nullptr);
+    writer->Join();
+    ok = ok && stats->numDiskWrites == writes + 1;
+    printf("Another thread wrote through: %s.\n", ok ? "ok" : "failed");
+
+    transactionTestBegun = false;
+    Thread *opener = new Thread("transaction opener", true);
+    opener->Fork(TransactionTestOpener, nullptr);
+    for (unsigned j = 0; j < 10; j++)
+        currentThread->Yield();
+    ok = ok && !transactionTestBegun;
+    synchDisk->CommitTransaction();
+    ok = ok && stats->numDiskWrites == writes + 2;
+    opener->Join();
+    ok = ok && transactionTestBegun;
+    printf("Another transaction waited for the commit: %s.\n",
+           ok ? "ok" : "failed");
+
+    delete [] transactionTestData;
+    printf("Transaction disk test %s.\n", ok ? "passed" : "failed");
+    return ok;
+}
+
+/// Defragmenter test
+///
+/// `DefragmenterTest` builds a fragmented file and runs a defragmenter pass
+/// while another thread keeps overwriting that file.
+
+/// Sectors of data of the file that `DefragmenterTest` fragments.
+static const unsigned DEFRAG_TEST_SECTORS = 12;
+
+/// Overwrite every sector of the fragmented file, yielding between writes
+/// so that they are mixed with the moves of the defragmenter.
+static void
+DefragTestWriter(void *)
+{
+    OpenFile *file = fileSystem->Open("/frag");
+    char *data = new char [SECTOR_SIZE];
+    for (unsigned i = 0; i < DEFRAG_TEST_SECTORS; i++) {
+        memset(data, 'A' + i, SECTOR_SIZE);
+        file->WriteAt(data, SECTOR_SIZE, i * SECTOR_SIZE);
+        currentThread->Yield();
+    }
+    delete [] data;
+    delete file;
+}
+
+/* Se escriben dos archivos de a un sector por vez, así sus bloques quedan
+   intercalados, y se borra uno.  Al final el que queda tiene que estar en
+   sectores consecutivos y con lo último que escribió el otro hilo, que no
+   se pierde aunque escriba mientras se copian los bloques. */
+static bool
+DefragmenterTest()
+{
+    printf("Starting defragmenter test:\n");
+    if (!fileSystem->Create("/frag", 0) || !fileSystem->Create("/gap", 0)) {
+        printf("Create failed.\n");
+        return false;
+    }
+    OpenFile *frag = fileSystem->Open("/frag");
+    OpenFile *gap = fileSystem->Open("/gap");
+    char *data = new char [SECTOR_SIZE];
+    memset(data, '-', SECTOR_SIZE);
+    for (unsigned i = 0; i < DEFRAG_TEST_SECTORS; i++) {
+        frag->Write(data, SECTOR_SIZE);
+        gap->Write(data, SECTOR_SIZE);
+    }
+    delete gap;
+    bool ok = fileSystem->Remove("/gap");
+
+    FileHeader *hdr = frag->GetHeader();
+    unsigned total = hdr->SectorsOnDisk();
+    unsigned *sectors = new unsigned [total];
+    hdr->ListSectors(sectors);
+    ok = ok && Defragmenter::FragmentationScore(sectors, total) > 0.5;
+    delete frag;
+    printf("Fragmented the file: %s.\n", ok ? "ok" : "failed");
+
+    Thread *writer = new Thread("defragmenter test writer", true);
+    writer->Fork(DefragTestWriter, nullptr);
+    currentThread->Yield();  // Some writes go before the move, some after.
+    Defragmenter defragmenter;
+    defragmenter.Run();
+    writer->Join();
+
+    frag = fileSystem->Open("/frag");
+    hdr = frag->GetHeader();
+    ok = ok && hdr->SectorsOnDisk() == total;
+    hdr->ListSectors(sectors);
+    ok = ok && Defragmenter::FragmentationScore(sectors, total) == 0;
+    printf("Moved the file to consecutive sectors: %s.\n",
+           ok ? "ok" : "failed");
+
+    for (unsigned i = 0; i < DEFRAG_TEST_SECTORS; i++) {
+        ok = ok && frag->ReadAt(data, SECTOR_SIZE, i * SECTOR_SIZE)
+                   == (int) SECTOR_SIZE;
+        for (unsigned j = 0; ok && j < SECTOR_SIZE; j++)
+            ok = data[j] == (char) ('A' + i);
+    }
+    printf("Kept the concurrent writes: %s.\n", ok ? "ok" : "failed");
+
+    delete frag;
+    delete [] sectors;
+    delete [] data;
+    ok = fileSystem->Remove("/frag") && ok;
+    printf("Defragmenter test %s.\n", ok ? "passed" : "failed");
+    return ok;
+}
+#endif
+
 void
 PerformanceTest()
 {
@@ -273,6 +703,11 @@ PerformanceTest()
         printf("Deleted `dir1` succesfully.\n");
     }
 
+    BTreeTest();
+    CursorTest();
+    TransactionOrderTest();
+    TransactionDiskTest();
+    DefragmenterTest();
     
     #else
     printf("Starting file system performance test:\n");
@@ -0,0 +1,106 @@
+/// Routines to keep the sectors written during a metadata transaction.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "metadata_transaction.hh"
+#include "machine/disk.hh"
+
+#include <string.h>
+
+
+MetadataTransaction::MetadataTransaction()
+{
+    owner = nullptr;
+    depth = 0;
+    count = 0;
+    dirty = new List<char *>;
+}
+
+MetadataTransaction::~MetadataTransaction()
+{
+    ASSERT(depth == 0 && count == 0);
+    delete dirty;
+}
+
+bool
+MetadataTransaction::Begin(Thread *thread)
+{
+    ASSERT(thread != nullptr);
+
+    if (depth > 0 && owner != thread)
+        return false;
+    owner = thread;
+    depth++;
+    return true;
+}
+
+bool
+MetadataTransaction::Commit(Thread *thread)
+{
+    ASSERT(depth > 0 && owner == thread);
+
+    if (--depth > 0)
+        return false;
+    owner = nullptr;
+    return true;
+}
+
+bool
+MetadataTransaction::Read(unsigned sector, char *data)
+{
+    ASSERT(data != nullptr);
+
+    char *contents = dirty->FindByKey(sector);
+    if (contents == nullptr)
+        return false;
+    memcpy(data, contents, SECTOR_SIZE);
+    return true;
+}
+
+/* Un sector que ya está pendiente se actualiza aunque lo escriba otro
+   hilo: si sólo se escribiera directo en el disco, la copia pendiente lo
+   pisaría después con datos viejos.  Igual ese hilo lo escribe también en
+   el disco, porque la transacción no es suya y no sabe cuándo termina. */
+bool
+MetadataTransaction::Write(unsigned sector, const char *data, Thread *writer)
+{
+    ASSERT(data != nullptr);
+
+    bool owned = depth > 0 && writer == owner;
+    char *contents = dirty->FindByKey(sector);
+    if (contents == nullptr) {
+        if (!owned)
+            return false;
+        contents = new char [SECTOR_SIZE];
+        dirty->SortedInsert(contents, sector);
+        count++;
+    }
+    memcpy(contents, data, SECTOR_SIZE);
+    return owned;
+}
+
+bool
+MetadataTransaction::IsFull() const
+{
+    return count >= TRANSACTION_MAX_SECTORS;
+}
+
+bool
+MetadataTransaction::PopFirst(unsigned *sector, char *data)
+{
+    ASSERT(sector != nullptr);
+    ASSERT(data != nullptr);
+
+    if (count == 0)
+        return false;
+    int key;
+    char *contents = dirty->SortedPop(&key);
+    *sector = key;
+    memcpy(data, contents, SECTOR_SIZE);
+    delete [] contents;
+    count--;
+    return true;
+}
@@ -0,0 +1,83 @@
+/// Batching of the metadata writes done by a file system operation.
+///
+/// Creating or removing a file rewrites the bitmap of free sectors, one or
+/// more directories and file headers, each with its own synchronous write,
+/// in whatever order the code happens to touch them.  Removing a directory
+/// does that again for every file below it, so the same bitmap and
+/// directory sectors are written over and over.
+///
+/// While a transaction is open, `SynchDisk` keeps every sector written in
+/// memory instead of sending it to the disk, and serves reads of those
+/// sectors from memory too.  When the outermost transaction commits, each
+/// dirty sector is written once, in increasing sector order, so the disk
+/// head sweeps the surface a single time.
+///
+/// Transactions nest: a recursive removal opens one per file, but only the
+/// outermost commit writes.  A transaction belongs to the thread that
+/// opened it, and only that thread's writes are kept; another thread that
+/// wants one waits until it commits.  Writes by other threads go to the
+/// disk as usual, instead of waiting for an operation they are not part
+/// of.  A sector kept by the transaction is still read from memory by every
+/// thread, and a write by another thread updates that copy too, so that
+/// the commit does not put back older contents.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_METADATATRANSACTION__HH
+#define NACHOS_FILESYS_METADATATRANSACTION__HH
+
+
+#include "lib/list.hh"
+
+
+class Thread;
+
+
+/// Dirty sectors kept before writing them anyway, even if the transaction
+/// is still open.
+const unsigned TRANSACTION_MAX_SECTORS = 64;
+
+/// The sectors written by the open transactions.  Mutual exclusion is
+/// provided by `SynchDisk`.
+class MetadataTransaction {
+public:
+
+    MetadataTransaction();
+
+    ~MetadataTransaction();
+
+    /// Open a transaction for `thread`.  Return false, without opening it,
+    /// if another thread has one open.
+    bool Begin(Thread *thread);
+
+    /// Close a transaction of `thread`.  Return true if it was the
+    /// outermost one, so the dirty sectors have to be written.
+    bool Commit(Thread *thread);
+
+    /// If `sector` is dirty, copy its contents into `data` and return true.
+    bool Read(unsigned sector, char *data);
+
+    /// Keep `data` as the new contents of `sector` if it is dirty, or if
+    /// `writer` has the transaction open.  Return true if `writer` owns the
+    /// transaction; otherwise the caller has to write it to the disk.
+    bool Write(unsigned sector, const char *data, Thread *writer);
+
+    /// Check whether there are too many dirty sectors to keep.
+    bool IsFull() const;
+
+    /// Take the dirty sector with the lowest number, copying its contents
+    /// into `data`.  Return false if there are no dirty sectors.
+    bool PopFirst(unsigned *sector, char *data);
+
+private:
+    Thread *owner;   ///< Thread with the transactions open, if any.
+    unsigned depth;  ///< Transactions currently open.
+    unsigned count;  ///< Number of dirty sectors.
+    List<char *> *dirty;  ///< Contents of the dirty sectors, sorted by
+                          ///< sector number.
+};
+
+
+#endif
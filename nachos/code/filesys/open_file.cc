@@ -33,6 +33,12 @@ OpenFile::OpenFile(int sector_, const char* name )
 }
 
 
+OpenFile *
+OpenFile::Reopen()
+{
+    return new OpenFile(sector);
+}
+
 /// Close a Nachos file, de-allocating any in-memory data structures.
 OpenFile::~OpenFile()
 {   
@@ -201,7 +207,10 @@ OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
         if(hdr->FileExpand(sizeToExpand, sector)){
             fileLength = hdr->FileLength();
         }
-        else return 0;
+        else {
+            file->WriterFree();
+            return 0;
+        }
     }
 
     DEBUG('f', "Writing %u bytes at %u, from file (%u) of length %u.\n",
@@ -248,3 +257,8 @@ unsigned
 OpenFile::GetSector(){
     return sector;
 }
+
+FileHeader *
+OpenFile::GetHeader(){
+    return hdr;
+}
@@ -79,6 +79,19 @@ public:
         return SystemDep::Tell(file);
     }
 
+    /// There are no sectors here; the UNIX inode number identifies the
+    /// file just as well as the sector of its header.
+    unsigned GetSector()
+    {
+        return SystemDep::FileId(file);
+    }
+
+    /// Open the same file again, with a descriptor of its own.
+    OpenFile *Reopen()
+    {
+        return new OpenFile(SystemDep::Dup(file));
+    }
+
 private:
     int file;
     unsigned currentOffset;
@@ -116,6 +129,13 @@ public:
 
     unsigned GetSector();
 
+    /// Open the same file again, with a seek position of its own.  The
+    /// file is not removed until both are closed.
+    OpenFile *Reopen();
+
+    /// Header of the file, as of the last read or write.
+    FileHeader *GetHeader();
+
   private:
     FileHeader *hdr;  ///< Header for this file.
     unsigned seekPosition;  ///< Current position within the file.
@@ -5,6 +5,8 @@
 // abs = /home/federico/dev/so2/nachos/code/filesys/test/big
 using namespace std;
 
+static char ROOT_NAME[] = "/";
+
 /* Construye un path a partir de un string. Dependiendo de si es un archivo, guarda el nombre del mismo en la propiedad fileName.
     Se guarda el nombre de cada subdirectorio que conforma el path en una lista.
     Ademas detecta si el path es relativo o absoluto. */
@@ -16,13 +18,11 @@ Path::Path(const char* path, bool isFile){
     fileName = nullptr;
     pathLength = 0;
     if (!isRelative) {
-        char root[2];
-        strcpy(root,"/");
-        dirPath->Append(root);
+        dirPath->Append(ROOT_NAME);
         pathLength++;
     }
 
-    char *path_ = new char[20];
+    char *path_ = new char[strlen(path) + 1];
     strcpy(path_,path);
     
     char *temp, *token = strtok( (char*) path_, "/");
@@ -72,7 +72,7 @@ Path::Length(){
     Utilizado para hacer comparaciones. */
 char* 
 Path::AppendToRaw(const char* path){
-    char *result = (char *) malloc(sizeof(char) * 60);   // array to hold the result.
+    char *result = (char *) malloc(strlen(rawPath) + strlen(path) + 2);   // array to hold the result.
 
     strcpy(result,rawPath); // copy string one into the result.
     strcat(result,"/");
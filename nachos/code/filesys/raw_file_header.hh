@@ -28,6 +28,8 @@ const unsigned MAX_FILE_SIZE = NUM_DIRECT * SECTOR_SIZE;
 
 struct RawFileHeader {
     bool isDirectory;
+    unsigned char directoryFormat;  ///< A `DirectoryFormat`; only meaningful
+                                    ///< for directories.
     unsigned numBytes;  ///< Number of bytes in the file.
     unsigned numSectors;  ///< Number of data sectors in the file.
     unsigned dataSectors[NUM_DIRECT + 2];  ///< Disk sector numbers for each data
@@ -14,6 +14,7 @@
 
 
 #include "synch_disk.hh"
+#include "threads/system.hh"
 
 
 /// Disk interrupt handler.  Need this to be a C routine, because C++ cannot
@@ -36,11 +37,15 @@ SynchDisk::SynchDisk(const char *name)
     semaphore = new Semaphore("synch disk", 0);
     lock = new Lock("synch disk lock");
     disk = new Disk(name, DiskRequestDone, this);
+    transaction = new MetadataTransaction;
+    transactionDone = new Condition("transaction done", lock);
 }
 
 /// De-allocate data structures needed for the synchronous disk abstraction.
 SynchDisk::~SynchDisk()
 {
+    delete transactionDone;
+    delete transaction;
     delete disk;
     delete lock;
     delete semaphore;
@@ -57,8 +62,8 @@ SynchDisk::ReadSector(int sectorNumber, char *data)
     ASSERT(data != nullptr);
 
     lock->Acquire();  // Only one disk I/O at a time.
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();   // Wait for interrupt.
+    if (!transaction->Read(sectorNumber, data))
+        DiskRead(sectorNumber, data);
     lock->Release();
 }
 
@@ -73,11 +78,59 @@ SynchDisk::WriteSector(int sectorNumber, const char *data)
     ASSERT(data != nullptr);
 
     lock->Acquire();  // only one disk I/O at a time
+    if (!transaction->Write(sectorNumber, data, currentThread))
+        DiskWrite(sectorNumber, data);
+    else if (transaction->IsFull())
+        Flush();
+    lock->Release();
+}
+
+void
+SynchDisk::DiskRead(int sectorNumber, char *data)
+{
+    disk->ReadRequest(sectorNumber, data);
+    semaphore->P();   // Wait for interrupt.
+}
+
+void
+SynchDisk::DiskWrite(int sectorNumber, const char *data)
+{
     disk->WriteRequest(sectorNumber, data);
-    semaphore->P();   // wait for interrupt
+    semaphore->P();   // Wait for interrupt.
+}
+
+void
+SynchDisk::BeginTransaction()
+{
+    lock->Acquire();
+    while (!transaction->Begin(currentThread))
+        transactionDone->Wait();
     lock->Release();
 }
 
+void
+SynchDisk::CommitTransaction()
+{
+    lock->Acquire();
+    if (transaction->Commit(currentThread)) {
+        Flush();
+        transactionDone->Broadcast();
+    }
+    lock->Release();
+}
+
+/* Los sectores salen en orden creciente, así el brazo del disco recorre la
+   superficie una sola vez.  Como se tiene `lock`, nadie puede leer ni
+   escribir mientras tanto. */
+void
+SynchDisk::Flush()
+{
+    unsigned sector;
+    char data[SECTOR_SIZE];
+    while (transaction->PopFirst(&sector, data))
+        DiskWrite(sector, data);
+}
+
 /// Disk interrupt handler.  Wake up any thread waiting for the disk
 /// request to finish.
 void
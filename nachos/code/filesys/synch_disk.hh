@@ -9,6 +9,7 @@
 #define NACHOS_FILESYS_SYNCHDISK__HH
 
 
+#include "metadata_transaction.hh"
 #include "machine/disk.hh"
 #include "threads/synch.hh"
 
@@ -43,12 +44,35 @@ public:
     /// current disk operation is complete.
     void RequestDone();
 
+    /// Open a metadata transaction for the current thread: until it
+    /// commits, the sectors the thread writes are kept in memory (see
+    /// `metadata_transaction.hh`).  Wait first if another thread has one
+    /// open.
+    void BeginTransaction();
+
+    /// Commit a metadata transaction.  If it is the outermost one, write
+    /// the dirty sectors in increasing order.
+    void CommitTransaction();
+
 private:
+
+    /// Write every dirty sector.  The caller must hold `lock`.
+    void Flush();
+
+    /// Read/write a sector on the disk itself.  The caller must hold
+    /// `lock`.
+    void DiskRead(int sectorNumber, char *data);
+    void DiskWrite(int sectorNumber, const char *data);
+
     Disk *disk;  ///< Raw disk device.
     Semaphore *semaphore;  ///< To synchronize requesting thread with the
                            ///< interrupt handler.
     Lock *lock;  ///< Only one read/write request can be sent to the disk at
                  ///< a time.
+    MetadataTransaction *transaction;  ///< Sectors written by the open
+                                       ///< transactions.
+    Condition *transactionDone;  ///< Signalled when the outermost
+                                 ///< transaction commits.
 };
 
 
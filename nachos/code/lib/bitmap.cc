@@ -24,13 +24,6 @@ Bitmap::Bitmap(unsigned nitems)
     numWords = DivRoundUp(numBits, BITS_IN_WORD);
     map      = new unsigned [numWords];
 
-    #ifdef USE_TLB
-    addrSpaceMap = new AddressSpace* [nitems];
-        #ifndef CLOCK
-        victimsQ = new List<unsigned>;
-        #endif
-    #endif
-
     for (unsigned i = 0; i < numBits; i++)
         Clear(i);
 }
@@ -39,14 +32,6 @@ Bitmap::Bitmap(unsigned nitems)
 Bitmap::~Bitmap()
 {
     delete [] map;
-    #ifdef USE_TLB
-        delete [] addrSpaceMap;
-        #ifndef CLOCK
-            delete victimsQ;
-        #endif
-    #endif
-  
-
 }
 
 /// Set the “nth” bit in a bitmap.
@@ -67,10 +52,6 @@ Bitmap::Clear(unsigned which)
 {
     ASSERT(which < numBits);
     map[which / BITS_IN_WORD] &= ~(1 << which % BITS_IN_WORD);
-    #ifdef USE_TLB
-        addrSpaceMap[which] = nullptr;
-    #endif
-
 }
 
 /// Return true if the “nth” bit is set.
@@ -88,28 +69,55 @@ Bitmap::Test(unsigned which) const
 ///
 /// If no bits are clear, return -1.
 int
-Bitmap::Find(AddressSpace *space)
+Bitmap::Find()
 {
-    for (unsigned i = 0; i < numBits; i++){
+    for (unsigned i = 0; i < numBits; i++)
         if (!Test(i)) {
             Mark(i);
-            
-            #ifdef USE_TLB
-            if(!space)
-                DEBUG('k', "Find called with null space.\n");
-
-            addrSpaceMap[i] = space;
-                #ifndef CLOCK
-                    if(!victimsQ->Has(i))
-                        victimsQ -> Append(i);
-                #endif
-            #endif
             return i;
         }
-    }
     return -1;
 }
 
+/// Return the first bit of a run of `count` clear bits, choosing among all
+/// the free stretches long enough the start closest to `hint`.  As a side
+/// effect, set all the bits of the run.
+///
+/// If there is no run that long, return -1.
+int
+Bitmap::FindContiguous(unsigned count, unsigned hint)
+{
+    ASSERT(count > 0);
+
+    int best = -1;
+    unsigned bestDistance = 0;
+    for (unsigned i = 0; i < numBits; ) {
+        if (Test(i)) {
+            i++;
+            continue;
+        }
+        unsigned start = i;
+        while (i < numBits && !Test(i))
+            i++;
+        if (i - start < count)
+            continue;
+
+        // Any start in `[start, i - count]` fits; take the nearest one.
+        unsigned first = hint < start ? start
+                       : hint > i - count ? i - count : hint;
+        unsigned distance = first > hint ? first - hint : hint - first;
+        if (best == -1 || distance < bestDistance) {
+            best = first;
+            bestDistance = distance;
+        }
+    }
+
+    if (best != -1)
+        for (unsigned j = best; j < best + count; j++)
+            Mark(j);
+    return best;
+}
+
 /// Return the number of clear bits in the bitmap.  (In other words, how many
 /// bits are unallocated?)
 unsigned
@@ -164,46 +172,3 @@ Bitmap::WriteBack(OpenFile *file) const
     DEBUG('f', "Writing back BitMap to file.\n");
     file->WriteAt((char *) map, numWords * sizeof (unsigned), 0);
 }
-
-#ifdef USE_TLB
-
-unsigned
-Bitmap::NextVictim(){
-#ifndef CLOCK
-    unsigned victim = victimsQ->Pop();
-   DEBUG('j', "Victim number (FIFO): %d \n", victim);
-   return victim;
-#else
-    unsigned idx = machine->GetMMU()->GetNextClockIdx();
-    AddressSpace* addr = addrSpaceMap[idx];
-    int vpn = addr->FindVirtualPage(idx);
-    TranslationEntry page = addr->GetPageTable()[vpn];
-    if(!addr->GetPageTable()[vpn].valid){
-        return NextVictim();
-    } else{
-        if(!addr->GetPageTable()[vpn].use){
-            DEBUG('j', "Victim number (CLOCK): %u\n", idx);
-            return idx;
-        }
-        else {
-            addr->GetPageTable()[vpn].use = false;
-            return NextVictim();
-        }
-    }
-#endif
-}
-
-void
-Bitmap::ClearPage(AddressSpace *currentThreadSpace){
-     unsigned tempId = NextVictim();
-     DEBUG('h',"TEMPID: %d\n", tempId);
-    
-    // Store process owner of that page.
-    AddressSpace *space = addrSpaceMap[tempId];
-
-    // Remove the victim page from the process address space.
-    space -> RemovePage(tempId);
-}
-
-
-#endif
\ No newline at end of file
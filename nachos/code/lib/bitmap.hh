@@ -20,9 +20,6 @@
 
 #include "utility.hh"
 #include "filesys/open_file.hh"
-#include "userprog/address_space.hh"
-#include "list.hh"
-#include "threads/system.hh"
 
 /// Definitions helpful for representing a bitmap as an array of integers.
 
@@ -61,7 +58,13 @@ public:
     /// Return the index of a clear bit, and as a side effect, set the bit.
     ///
     /// If no bits are clear, return -1.
-    int Find(AddressSpace *space = nullptr);
+    int Find();
+
+    /// Return the index of a run of `count` consecutive clear bits, as
+    /// close to `hint` as possible, and as a side effect, set them.
+    ///
+    /// If there is no such run, return -1.
+    int FindContiguous(unsigned count, unsigned hint = 0);
 
     /// Return the number of clear bits.
     unsigned CountClear() const;
@@ -81,11 +84,6 @@ public:
     /// need to read and write the bitmap to a file.
     void WriteBack(OpenFile *file) const;
 
-    #ifdef USE_TLB
-    void ClearPage(AddressSpace *currentThreadSpace);
-    unsigned NextVictim();
-    #endif
-
 private:
 
     /// Number of bits in the bitmap.
@@ -97,15 +95,6 @@ private:
 
     /// Bit storage.
     unsigned *map;
-
-
-    #ifdef USE_TLB
-    AddressSpace** addrSpaceMap;
-        #ifndef CLOCK
-        List<unsigned> *victimsQ;
-        #endif
-    #endif
-
 };
 
 
@@ -257,8 +257,10 @@ Disk::UpdateLast(unsigned newSector)
     unsigned rotate;
     unsigned seek = TimeToSeek(newSector, &rotate);
 
-    if (seek != 0)
+    if (seek != 0) {
         bufferInit = stats->totalTicks + seek + rotate;
+        stats->numDiskSeeks++;
+    }
     lastSector = newSector;
     DEBUG('d', "Updating last sector = %u, %u\n", lastSector, bufferInit);
 }
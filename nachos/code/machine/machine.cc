@@ -89,17 +89,13 @@ Machine::WriteRegister(unsigned num, int value)
 }
 
 bool
-Machine::ReadMem(unsigned addr, unsigned size, int *value, bool count)
+Machine::ReadMem(unsigned addr, unsigned size, int *value)
 {
     ExceptionType e = mmu.ReadMem(addr, size, value);
     if (e != NO_EXCEPTION) {
         RaiseException(e, addr);
-        stats->numPageFaults++;
         return false;
     }
-    if(count)
-        stats->numPageHits++;
-
     return true;
 }
 
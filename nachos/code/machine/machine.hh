@@ -88,7 +88,7 @@ public:
     /// Wrappers for MMU methods.  These wrappers raise an exception in the
     /// machine if needed.
 
-    bool ReadMem(unsigned addr, unsigned size, int *value, bool count = true);
+    bool ReadMem(unsigned addr, unsigned size, int *value);
 
     bool WriteMem(unsigned addr, unsigned size, int value);
 
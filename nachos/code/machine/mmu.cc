@@ -30,6 +30,8 @@
 
 #include "mmu.hh"
 #include "endianness.hh"
+#include "system_dep.hh"
+#include "threads/system.hh"
 
 
 MMU::MMU()
@@ -39,14 +41,13 @@ MMU::MMU()
           mainMemory[i] = 0;
 
 #ifdef USE_TLB
-    tlb = new TranslationEntry[TLB_SIZE];
-    for (unsigned i = 0; i < TLB_SIZE; i++)
-        tlb[i].valid = false;
+    tlb        = nullptr;
+    nextVictim = nullptr;
+    lastUse    = nullptr;
+    referenced = nullptr;
+    ConfigureTLB(TLB_SIZE, TLB_SIZE, TLB_FIFO);
     pageTable = nullptr;
-    firstInIdx = 0;
-    #ifdef CLOCK
-    clock = 0;
-    #endif 
+    asid = 0;
 #else  // Use linear page table.
     tlb = nullptr;
     pageTable = nullptr;
@@ -58,6 +59,11 @@ MMU::~MMU()
     delete [] mainMemory;
     if (tlb != nullptr)
         delete [] tlb;
+#ifdef USE_TLB
+    delete [] nextVictim;
+    delete [] lastUse;
+    delete [] referenced;
+#endif
 }
 
 /// Read `size` (1, 2, or 4) bytes of virtual memory at `addr` into
@@ -149,7 +155,7 @@ MMU::WriteMem(unsigned addr, unsigned size, int value)
 }
 
 ExceptionType
-MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
+MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry)
 {
     ASSERT(entry != nullptr);
 
@@ -172,14 +178,20 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
         return NO_EXCEPTION;
 
     } else {
-        // Use the TLB.
-        unsigned i;
-        for (i = 0; i < TLB_SIZE; i++)
-            if (tlb[i].valid && tlb[i].virtualPage == vpn) {
+        // Use the TLB.  Only the set where `vpn` can be is searched.
+#ifdef USE_TLB
+        unsigned first = SetOf(vpn) * tlbWays;
+        for (unsigned i = first; i < first + tlbWays; i++)
+            if (tlb[i].valid && tlb[i].virtualPage == vpn
+                  && tlb[i].asid == asid) {
                 *entry = &tlb[i];  // FOUND!
-
+                lastUse[i] = ++accesses;
+                referenced[i] = true;
+                stats->numTLBHits++;
                 return NO_EXCEPTION;
             }
+        stats->numTLBMisses++;
+#endif
 
         // Not found.
         DEBUG_CONT('a', "no valid TLB entry found for this virtual page!\n");
@@ -255,19 +267,97 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
 }
 
 #ifdef USE_TLB
-int
-MMU::GetNextIdx(){
-    int id = firstInIdx;
-    firstInIdx = (firstInIdx+1) % TLB_SIZE;
-    return id;
+/// Names of the replacement policies, in the order of `TLBPolicy`.
+static const char *TLB_POLICY_NAMES[] = { "FIFO", "random", "LRU", "CLOCK" };
+
+void
+MMU::ConfigureTLB(unsigned size, unsigned ways, TLBPolicy policy)
+{
+    // An instruction may need two translations at once, the one of its own
+    // address and the one of the data it loads or stores; with a single way
+    // both pages could keep evicting each other from the same set.
+    ASSERT(ways >= 2 && ways <= size && size % ways == 0);
+
+    tlbSize   = size;
+    tlbWays   = ways;
+    numSets   = size / ways;
+    tlbPolicy = policy;
+    accesses  = 0;
+
+    delete [] tlb;
+    delete [] nextVictim;
+    delete [] lastUse;
+    delete [] referenced;
+    tlb        = new TranslationEntry [tlbSize];
+    nextVictim = new unsigned [numSets];
+    lastUse    = new unsigned long [tlbSize];
+    referenced = new bool [tlbSize];
+    for (unsigned i = 0; i < tlbSize; i++) {
+        tlb[i].valid  = false;
+        lastUse[i]    = 0;
+        referenced[i] = false;
+    }
+    for (unsigned i = 0; i < numSets; i++)
+        nextVictim[i] = 0;
+
+    stats->tlbSize   = tlbSize;
+    stats->tlbWays   = tlbWays;
+    stats->tlbPolicy = TLB_POLICY_NAMES[tlbPolicy];
 }
-#ifdef CLOCK
-int
-MMU::GetNextClockIdx(){
-    int actual = clock;
-    clock++;
-    clock%=NUM_PHYS_PAGES;
-    return actual;
+
+unsigned
+MMU::GetTLBSize() const
+{
+    return tlbSize;
+}
+
+/* Todos los procesos usan las mismas páginas virtuales bajas para el
+   código y los datos, así que el conjunto se elige mezclando el número de
+   página con el identificador del espacio de direcciones; si no, las
+   entradas de procesos distintos competirían siempre por el mismo
+   conjunto. */
+unsigned
+MMU::SetOf(unsigned vpn) const
+{
+    return (vpn ^ asid) % numSets;
+}
+
+unsigned
+MMU::GetNextIdx(unsigned vpn)
+{
+    unsigned set = SetOf(vpn);
+    unsigned first = set * tlbWays;
+    for (unsigned i = first; i < first + tlbWays; i++)
+        if (!tlb[i].valid)
+            return i;
+
+    switch (tlbPolicy) {
+        case TLB_RANDOM:
+            return first + SystemDep::Random() % tlbWays;
+
+        case TLB_LRU: {
+            unsigned victim = first;
+            for (unsigned i = first + 1; i < first + tlbWays; i++)
+                if (lastUse[i] < lastUse[victim])
+                    victim = i;
+            return victim;
+        }
+
+        case TLB_CLOCK:
+            // Ends at most after one turn, once every bit is cleared.
+            for (;;) {
+                unsigned i = first + nextVictim[set];
+                nextVictim[set] = (nextVictim[set] + 1) % tlbWays;
+                if (!referenced[i])
+                    return i;
+                referenced[i] = false;
+            }
+
+        default: {  // TLB_FIFO
+            unsigned i = first + nextVictim[set];
+            nextVictim[set] = (nextVictim[set] + 1) % tlbWays;
+            return i;
+        }
+    }
 }
-#endif
 #endif
\ No newline at end of file
@@ -16,16 +16,40 @@
 
 /// Definitions related to the size, and format of user memory.
 
-const unsigned PAGE_SIZE = SECTOR_SIZE;  ///< Set the page size equal to the
-                                         ///< disk sector size, for
-                                         ///< simplicity.
-#ifdef VMEM                                    
-const unsigned NUM_PHYS_PAGES = 16;
+/// Bytes of main memory.  They do not depend on the page size, so that
+/// runs with different page sizes compare the same amount of memory.
+#ifdef VMEM
+const unsigned MEMORY_SIZE = 16 * SECTOR_SIZE;
 #else
-const unsigned NUM_PHYS_PAGES = 256;
+const unsigned MEMORY_SIZE = 256 * SECTOR_SIZE;
 #endif
-const unsigned MEMORY_SIZE = NUM_PHYS_PAGES * PAGE_SIZE;
+
+/// Bytes per page.  By default a page is a disk sector, for simplicity; a
+/// bigger power of two can be chosen when building, with `PAGE_BYTES` (see
+/// `Makefile.common`).  Pages are then read from and written to swap a
+/// sector at a time.  Memory keeps its size, so there are fewer frames.
+#ifdef PAGE_BYTES
+const unsigned PAGE_SIZE = PAGE_BYTES;
+#else
+const unsigned PAGE_SIZE = SECTOR_SIZE;
+#endif
+static_assert(PAGE_SIZE >= SECTOR_SIZE && (PAGE_SIZE & (PAGE_SIZE - 1)) == 0,
+              "the page size must be a power of two, and a sector at least");
+
+const unsigned NUM_PHYS_PAGES = MEMORY_SIZE / PAGE_SIZE;
+static_assert(NUM_PHYS_PAGES >= 4,
+              "the page size leaves fewer than 4 frames of main memory");
 const unsigned TLB_SIZE = 4;  ///< if there is a TLB, make it small.
+                              ///< This is the default; it can be changed
+                              ///< at startup.
+
+/// How the entry to replace is chosen among the entries of a TLB set.
+enum TLBPolicy {
+    TLB_FIFO,    ///< The entry loaded first.
+    TLB_RANDOM,  ///< Any entry.
+    TLB_LRU,     ///< The entry used least recently.
+    TLB_CLOCK    ///< The first entry not used since the hand last passed.
+};
 
 
 /// This class simulates an MMU (memory management unit) that can use either
@@ -80,23 +104,60 @@ public:
     TranslationEntry *pageTable;
     unsigned pageTableSize;
 
+    /// Identifier of the running address space.  Only TLB entries tagged
+    /// with it are matched, so the TLB need not be flushed on a context
+    /// switch.
+    unsigned asid;
+
     #ifdef USE_TLB
-    int GetNextIdx();
-    int GetNextClockIdx();
+    /// Give the TLB `size` entries, grouped in sets of `ways` entries, and
+    /// choose the entry to replace within a set by `policy`.  A virtual
+    /// page can only be loaded in the set `(vpn ^ asid) % numSets` (see
+    /// `SetOf`); with `ways` equal to `size` the TLB is fully associative.
+    /// `ways` must be at least 2 and divide `size`: a direct-mapped TLB is
+    /// not supported.
+    ///
+    /// The contents of the TLB are lost.
+    void ConfigureTLB(unsigned size, unsigned ways, TLBPolicy policy);
+
+    unsigned GetTLBSize() const;
+
+    /// Return the index of the TLB entry where the translation of `vpn`
+    /// has to be loaded: a free entry of its set if there is one, or else
+    /// the one chosen by the replacement policy.
+    unsigned GetNextIdx(unsigned vpn);
     #endif
 
 private:
 
     #ifdef USE_TLB
-    unsigned firstInIdx;
-    #ifdef CLOCK
-    unsigned clock;
-    #endif  
+    unsigned tlbSize;
+    unsigned tlbWays;
+    unsigned numSets;
+    TLBPolicy tlbPolicy;
+
+    /// Per set: the next entry to replace in FIFO order, or the position of
+    /// the clock hand.
+    unsigned *nextVictim;
+
+    /// Per entry: the value of `accesses` at its last use, for LRU.
+    unsigned long *lastUse;
+
+    /// Per entry: whether it was used since the clock hand last passed.  It
+    /// is kept apart from the `use` bit, which belongs to the page.
+    bool *referenced;
+
+    /// Number of translations done through the TLB.
+    unsigned long accesses;
+
+    /// The set of the TLB where the translation of `vpn` for the current
+    /// address space can be.
+    unsigned SetOf(unsigned vpn) const;
     #endif
 
     /// Retrieve a page entry either from a page table or the TLB.
     ExceptionType RetrievePageEntry(unsigned vpn,
-                                    TranslationEntry **entry) const;
+                                    TranslationEntry **entry);
 
     /// Translate an address, and check for alignment.
     ///
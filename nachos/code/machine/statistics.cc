@@ -9,8 +9,8 @@
 
 
 #include "statistics.hh"
+#include "mmu.hh"
 #include "lib/utility.hh"
-#include "machine/mmu.hh"
 
 #include <stdio.h>
 
@@ -19,9 +19,28 @@
 Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
-    numDiskReads = numDiskWrites = 0;
+    numDiskReads = numDiskWrites = numDiskSeeks = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPageHits = numPacketsSent = numPacketsRecvd = 0;
+    numTLBHits = numTLBMisses = 0;
+    tlbSize = tlbWays = 0;
+    tlbPolicy = nullptr;
+    numPagesLoaded = numSwapReads = numPagesPrefetched = 0;
+    numPagesShared = 0;
+    numPagesCopied = numPagesReclaimed = 0;
+    numZeroPagesMapped = numZeroPagesFilled = 0;
+    numPageTablesCreated = numPageTablesReclaimed = 0;
+    numMappedReads = numMappedWrites = 0;
+    numSwapWrites = numPagesSwappedOut = numCleanEvictions = 0;
+    numSwapCacheHits = numSwapCacheMisses = 0;
+    numPagesCompressed = numCompressedBytes = numZeroPagesCached = 0;
+    numPagesIncompressible = numPagesSpilled = 0;
+    pagePolicy = nullptr;
+    numPageoutRuns = numPagesPagedOut = numSyncEvictions = 0;
+    numProcessesSuspended = numAdmissionsDeferred = numProcessesResumed = 0;
+    for (unsigned i = 0; i < FAULT_LATENCY_BUCKETS; i++)
+        faultLatency[i] = 0;
+    maxFaultLatency = 0;
 #ifdef DFS_TICKS_FIX
     tickResets = 0;
 #endif
@@ -40,12 +59,99 @@ Statistics::Print()
 #endif
     printf("Ticks: total %lu, idle %lu, system %lu, user %lu\n",
            totalTicks, idleTicks, systemTicks, userTicks);
-    printf("Disk I/O: reads %lu, writes %lu\n", numDiskReads, numDiskWrites);
+    printf("Disk I/O: reads %lu, writes %lu, seeks %lu\n",
+           numDiskReads, numDiskWrites, numDiskSeeks);
     printf("Console I/O: reads %lu, writes %lu\n",
            numConsoleCharsRead, numConsoleCharsWritten);
-    printf("Paging: \n - faults: %lu\n - hits: %lu\n", numPageFaults, numPageHits);
-    if(numPageFaults || numPageHits)
-        printf("Hit ratio %lu%% TLB_SIZE: %d\n", numPageHits*100/(numPageFaults+numPageHits),TLB_SIZE);
+    if (numPageFaults || numPageHits)
+        printf("Paging (%u-byte pages): faults %lu, pages found in memory "
+               "%lu, hit ratio %.3f%%\n", PAGE_SIZE, numPageFaults, numPageHits,
+               100.0 * numPageHits / (numPageFaults + numPageHits));
+    if (numTLBHits || numTLBMisses)
+        printf("TLB (%u entries, %u-way, %s): hits %lu, misses %lu, "
+               "miss rate %.3f%%\n",
+               tlbSize, tlbWays, tlbPolicy, numTLBHits, numTLBMisses,
+               100.0 * numTLBMisses / (numTLBHits + numTLBMisses));
+    if (numPagesLoaded)
+        printf("Replacement (%s): pages loaded %lu (%lu around faults), "
+               "swap reads %lu, swap writes %lu (%lu pages), "
+               "clean evictions %lu\n",
+               pagePolicy, numPagesLoaded, numPagesPrefetched, numSwapReads,
+               numSwapWrites, numPagesSwappedOut, numCleanEvictions);
+    if (numSwapCacheHits || numSwapCacheMisses || numPagesIncompressible
+          || numPagesCompressed || numZeroPagesCached) {
+        unsigned long reads = numSwapCacheHits + numSwapCacheMisses;
+        unsigned long kept  = numPagesCompressed + numZeroPagesCached;
+        printf("Swap cache: hits %lu, misses %lu, hit rate %lu%%; "
+               "pages kept %lu (%lu zero, %lu compressed to %lu%%), "
+               "incompressible %lu, spilled %lu; disk transfers avoided %lu\n",
+               numSwapCacheHits, numSwapCacheMisses,
+               reads ? numSwapCacheHits * 100 / reads : 0,
+               kept, numZeroPagesCached, numPagesCompressed,
+               numPagesCompressed
+                 ? numCompressedBytes * 100 / (numPagesCompressed * PAGE_SIZE)
+                 : 0,
+               numPagesIncompressible, numPagesSpilled,
+               numSwapCacheHits + kept - numPagesSpilled);
+    }
+    if (numPageoutRuns || numSyncEvictions)
+        printf("Pageout: daemon runs %lu, pages evicted %lu; "
+               "evictions in faults %lu\n",
+               numPageoutRuns, numPagesPagedOut, numSyncEvictions);
+    if (numProcessesSuspended || numAdmissionsDeferred)
+        printf("Load control: programs suspended %lu, admitted suspended "
+               "%lu, resumed %lu\n",
+               numProcessesSuspended, numAdmissionsDeferred,
+               numProcessesResumed);
+    if (maxFaultLatency)
+        printf("Page fault latency (ticks): p50 < %lu, p90 < %lu, "
+               "p99 < %lu, max %lu\n",
+               FaultLatencyPercentile(50), FaultLatencyPercentile(90),
+               FaultLatencyPercentile(99), maxFaultLatency);
+    if (numPagesShared)
+        printf("Shared code pages: %lu\n", numPagesShared);
+    if (numPagesCopied || numPagesReclaimed)
+        printf("Copy on write: pages copied %lu, pages reclaimed %lu\n",
+               numPagesCopied, numPagesReclaimed);
+    if (numPageTablesCreated)
+        printf("Page tables: second-level tables created %lu, freed %lu\n",
+               numPageTablesCreated, numPageTablesReclaimed);
+    if (numZeroPagesMapped)
+        printf("Zero-fill pages: mapped to the frame of zeroes %lu, "
+               "given a frame when written %lu\n",
+               numZeroPagesMapped, numZeroPagesFilled);
+    if (numMappedReads || numMappedWrites)
+        printf("Mapped files: pages read %lu, pages written back %lu\n",
+               numMappedReads, numMappedWrites);
     printf("Network I/O: packets received %lu, sent %lu\n",
            numPacketsRecvd, numPacketsSent);
 }
+
+void
+Statistics::RecordFaultLatency(unsigned long ticks)
+{
+    unsigned bucket = 0;
+    while (bucket < FAULT_LATENCY_BUCKETS - 1 && ticks >> (bucket + 1) != 0)
+        bucket++;
+    faultLatency[bucket]++;
+    if (ticks > maxFaultLatency)
+        maxFaultLatency = ticks;
+}
+
+/* Se busca el primer balde en el que la cantidad acumulada de fallos llega
+   al porcentaje pedido; su cota superior es la del percentil. */
+unsigned long
+Statistics::FaultLatencyPercentile(unsigned percent) const
+{
+    unsigned long total = 0;
+    for (unsigned i = 0; i < FAULT_LATENCY_BUCKETS; i++)
+        total += faultLatency[i];
+
+    unsigned long count = 0;
+    for (unsigned i = 0; i < FAULT_LATENCY_BUCKETS; i++) {
+        count += faultLatency[i];
+        if (count * 100 >= total * percent)
+            return 2UL << i;
+    }
+    return maxFaultLatency;
+}
@@ -11,6 +11,9 @@
 #define NACHOS_MACHINE_STATS__HH
 
 
+/// Number of buckets of the histogram of page fault latencies.
+const unsigned FAULT_LATENCY_BUCKETS = 32;
+
 /// The following class defines the statistics that are to be kept about
 /// Nachos behavior -- how much time (ticks) elapsed, how many user
 /// instructions executed, etc.
@@ -38,18 +41,110 @@ public:
     /// Number of disk write requests.
     unsigned long numDiskWrites;
 
+    /// Number of disk requests that moved the head to another track.
+    unsigned long numDiskSeeks;
+
     /// Number of characters read from the keyboard.
     unsigned long numConsoleCharsRead;
 
     /// Number of characters written to the display.
     unsigned long numConsoleCharsWritten;
 
-    /// Number of virtual memory page faults.
+    /// Number of TLB misses on pages that were not in memory, and on pages
+    /// that were, so only their translation had to be loaded.
     unsigned long numPageFaults;
-
-    /// Number of virtual memory page requests.
     unsigned long numPageHits;
 
+    /// Number of translations found in the TLB.
+    unsigned long numTLBHits;
+
+    /// Number of translations not found in the TLB.
+    unsigned long numTLBMisses;
+
+    /// Organization of the TLB the counters above refer to: number of
+    /// entries, entries per set and name of the replacement policy.
+    unsigned tlbSize;
+    unsigned tlbWays;
+    const char *tlbPolicy;
+
+    /// Number of pages brought into main memory, how many of them were
+    /// read from swap, and how many were loaded around a faulting page.
+    unsigned long numPagesLoaded;
+    unsigned long numSwapReads;
+    unsigned long numPagesPrefetched;
+
+    /// Number of code pages found already in memory, loaded by another
+    /// process running the same executable.
+    unsigned long numPagesShared;
+
+    /// Number of pages shared by `Fork` that were copied when written, and
+    /// of those that were given to the only process still mapping them.
+    unsigned long numPagesCopied;
+    unsigned long numPagesReclaimed;
+
+    /// Number of faults on pages never written that mapped the frame of
+    /// zeroes, and of those pages that got a frame of their own, zeroed,
+    /// when written.
+    unsigned long numZeroPagesMapped;
+    unsigned long numZeroPagesFilled;
+
+    /// Number of second-level page tables created, and of those freed
+    /// because none of their pages was in memory.
+    unsigned long numPageTablesCreated;
+    unsigned long numPageTablesReclaimed;
+
+    /// Number of pages of files mapped with `Mmap` read from the file, and
+    /// written back to it.
+    unsigned long numMappedReads;
+    unsigned long numMappedWrites;
+
+    /// Number of transfers to swap, and pages written in them.
+    unsigned long numSwapWrites;
+    unsigned long numPagesSwappedOut;
+
+    /// Number of pages evicted without writing them anywhere, because they
+    /// were not modified since they were loaded or last saved.
+    unsigned long numCleanEvictions;
+
+    /// Pages read from swap that were found in the in-memory cache of
+    /// compressed pages, and that had to be read from the disk.
+    unsigned long numSwapCacheHits;
+    unsigned long numSwapCacheMisses;
+
+    /// Pages written to swap that were kept in the cache: compressed, with
+    /// the bytes they took, and made only of zeroes.  Pages that did not
+    /// compress and were written to the disk.  Pages written to the disk
+    /// to make room in the cache.
+    unsigned long numPagesCompressed;
+    unsigned long numCompressedBytes;
+    unsigned long numZeroPagesCached;
+    unsigned long numPagesIncompressible;
+    unsigned long numPagesSpilled;
+
+    /// Name of the page replacement policy the counters above refer to.
+    const char *pagePolicy;
+
+    /// Number of times the pageout daemon woke up, and pages it evicted.
+    unsigned long numPageoutRuns;
+    unsigned long numPagesPagedOut;
+
+    /// Number of pages evicted by a faulting thread because there were no
+    /// free frames.
+    unsigned long numSyncEvictions;
+
+    /// Number of programs suspended by load control, of those that started
+    /// suspended because they did not fit when admitted, and of programs
+    /// resumed.
+    unsigned long numProcessesSuspended;
+    unsigned long numAdmissionsDeferred;
+    unsigned long numProcessesResumed;
+
+    /// Ticks taken by the page faults that loaded a page: entry `i` counts
+    /// those that took less than 2^(i+1) ticks, and at least 2^i if `i` is
+    /// not 0.
+    unsigned long faultLatency[FAULT_LATENCY_BUCKETS];
+    unsigned long maxFaultLatency;
+
     /// Number of packets sent over the network.
     unsigned long numPacketsSent;
 
@@ -66,6 +161,15 @@ public:
 
     /// Print collected statistics.
     void Print();
+
+    /// Account for a page fault that took `ticks` to load a page.
+    void RecordFaultLatency(unsigned long ticks);
+
+private:
+
+    /// Upper bound of the latency of the fastest `percent` per cent of the
+    /// page faults.
+    unsigned long FaultLatencyPercentile(unsigned percent) const;
 };
 
 /// Constants used to reflect the relative time an operation would take in a
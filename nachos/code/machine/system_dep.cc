@@ -35,6 +35,7 @@ extern "C" {
 #include <sys/socket.h>
 #include <sys/file.h>
 #include <sys/un.h>
+#include <sys/stat.h>
 #include <sys/mman.h>
 #ifdef HOST_i386
 #include <sys/time.h>
@@ -180,6 +181,19 @@ Tell(int fd)
 #endif
 }
 
+/// Report a number that identifies an open file among the existing ones:
+/// its inode number.
+///
+/// Abort on error.
+unsigned
+FileId(int fd)
+{
+    struct stat st;
+    int retVal = fstat(fd, &st);
+    ASSERT(retVal >= 0);
+    return st.st_ino;
+}
+
 /// Close a file.
 ///
 /// Abort on error.
@@ -190,6 +204,17 @@ Close(int fd)
     ASSERT(retVal >= 0);
 }
 
+/// Open another descriptor for the file open as `fd`.
+///
+/// Abort on error.
+int
+Dup(int fd)
+{
+    int newFd = dup(fd);
+    ASSERT(newFd >= 0);
+    return newFd;
+}
+
 /// Delete a file.
 bool
 Unlink(const char *name)
@@ -41,8 +41,12 @@ namespace SystemDep {
 
     int Tell(int fd);
 
+    unsigned FileId(int fd);
+
     void Close(int fd);
 
+    int Dup(int fd);
+
     bool Unlink(const char *name);
 
     /// Interprocess communication operations, for simulating the network.
@@ -54,6 +54,11 @@ public:
     /// This bit is set by the hardware every time the page is modified.
     bool dirty;
 
+    /// The address space the page belongs to.  The TLB can hold entries of
+    /// several address spaces at once; only those tagged with the running
+    /// one are used to translate.
+    unsigned asid;
+
 };
 
 
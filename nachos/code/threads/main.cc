@@ -12,8 +12,13 @@
 ///
 ///     nachos [-d <debugflags>] [-p] [-rs <random seed #>] [-z]
 ///            [-s] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
-///            [-f] [-cp <unix file> <nachos file>] [-pr <nachos file>]
-///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf]
+///            [-tlb <entries>] [-tlbways <ways>]
+///            [-tlbrep fifo | random | lru | clock]
+///            [-pageout <low> <high>] [-loadctl <high> <low>]
+///            [-pagerep fifo | clock | esc | aging | wsclock]
+///            [-swapcache <bytes>]
+///            [-f | -fb] [-cp <unix file> <nachos file>] [-pr <nachos file>]
+///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf] [-df]
 ///            [-n <network reliability>] [-id <machine id>]
 ///            [-tn <other machine id>]
 ///
@@ -33,10 +38,40 @@
 /// * `-x`  -- runs a user program.
 /// * `-tc` -- tests the console.
 ///
+/// *USE_TLB* options
+/// ------------------
+///
+/// * `-tlb`     -- sets the number of entries of the TLB.
+/// * `-tlbways` -- sets the associativity of the TLB, at least 2; by default
+///   it is fully associative.
+/// * `-tlbrep`  -- chooses the policy that picks the TLB entry to replace on
+///   a miss.
+/// * `-pageout` -- sets the watermarks of the pageout daemon: it wakes up
+///   when fewer than `low` frames are free, and evicts pages until `high`
+///   are.  By default they are 1/16 and 1/8 of memory; `-pageout 0 0`
+///   disables the daemon.
+/// * `-loadctl` -- sets when load control suspends programs to avoid
+///   thrashing: with more than `high` page faults per thousand user
+///   instructions, if their working sets do not fit in memory.  They are
+///   resumed with fewer than `low`.  By default they are 10 and 2;
+///   `-loadctl 0 0` disables load control.
+///
+/// *VMEM* options
+/// ---------------
+///
+/// * `-pagerep` -- chooses the page replacement policy: FIFO, CLOCK,
+///   enhanced second chance, aging or WSClock.  CLOCK is the default if
+///   Nachos was compiled with `CLOCK`, and FIFO otherwise.
+/// * `-swapcache` -- sets how many bytes of compressed pages are kept in
+///   memory before writing them to the swap disk; by default, half the
+///   size of main memory.  With 0, only pages of zeroes stay out of it.
+///
 /// *FILESYS* options
 /// -----------------
 ///
 /// * `-f`  -- causes the physical disk to be formatted.
+/// * `-fb` -- formats the disk like `-f`, but stores directories as B+-trees
+///   instead of linear tables.
 /// * `-cp` -- copies a file from UNIX to Nachos.
 /// * `-pr` -- prints a Nachos file to standard output.
 /// * `-rm` -- removes a Nachos file from the file system.
@@ -44,6 +79,8 @@
 /// * `-D`  -- prints the contents of the entire file system.
 /// * `-c`  -- checks the filesystem integrity.
 /// * `-tf` -- tests the performance of the Nachos file system.
+/// * `-df` -- starts the defragmenter thread, which runs concurrently with
+///   the commands that follow it.
 ///
 /// *NETWORK* options
 /// -----------------
@@ -68,6 +105,9 @@
 #include "system.hh"
 #include "lib/utility.hh"
 //#include "filesys/path.hh"
+#ifdef FILESYS
+    #include "filesys/defragmenter.hh"
+#endif
 
 #include <stdio.h>
 #include <string.h>
@@ -181,6 +221,8 @@ main(int argc, char **argv)
                    result ? "succeeded" : "failed");
         } else if (!strcmp(*argv, "-tf")){    // Performance test.
             PerformanceTest();
+        } else if (!strcmp(*argv, "-df")) {  // Start the defragmenter.
+            (new Defragmenter)->Start();
         }
         #ifdef DIRECTORY
          else if (!strcmp(*argv, "-cd")){
@@ -238,8 +238,8 @@ Condition::Signal()
 void
 Condition::Broadcast()
 {
-    if(!queue->IsEmpty())
-        for(Semaphore* awaken = queue->Pop(); !queue->IsEmpty();awaken = queue->Pop(), awaken->V());
+    while(!queue->IsEmpty())
+        queue->Pop()->V();
 }
 
 Channel::Channel(const char *debugName, int buffSize){
@@ -15,8 +15,14 @@
 #include "userprog/exception.hh"
 // #include "userprog/synch_console.hh"
 #endif
+#ifdef VMEM
+#include "vmem/core_map.hh"
+#include "vmem/load_control.hh"
+#include "vmem/swap_area.hh"
+#endif
 
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -46,6 +52,7 @@ FileSystem *fileSystem;
 #ifdef FILESYS
 FileTable *files;
 SynchDisk *synchDisk;
+Lock *freeMapLock;
 
 #endif
 
@@ -54,6 +61,11 @@ SynchConsole *synchConsole;
 // Table<Thread*> *processTable;
 Bitmap *freeMemMap;
 Machine *machine;  ///< User program memory and registers.
+#ifdef VMEM
+CoreMap *coreMap;
+SwapArea *swapArea;
+LoadControl *loadControl = nullptr;
+#endif
 #endif
 
 #ifdef NETWORK
@@ -82,6 +94,10 @@ TimerInterruptHandler(void *dummy)
 {
     if (interrupt->GetStatus() != IDLE_MODE)
         interrupt->YieldOnReturn();
+#ifdef USE_TLB
+    if (loadControl != nullptr)
+        loadControl->Tick();
+#endif
 }
 
 // ForcedSwitchChange
@@ -114,9 +130,31 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
     bool debugUserProg = false;  // Single step user program.
 #endif
+#ifdef VMEM
+#ifdef CLOCK
+    PagePolicy pagePolicy = PAGE_CLOCK;  // Page replacement policy.
+#else
+    PagePolicy pagePolicy = PAGE_FIFO;   // Page replacement policy.
+#endif
+    unsigned swapCacheSize = MEMORY_SIZE / 2;  // Bytes of compressed pages
+                                               // kept out of the disk.
+#endif
+#ifdef USE_TLB
+    unsigned tlbSize = TLB_SIZE;      // Entries of the TLB.
+    unsigned tlbWays = 0;             // Associativity; 0 means fully.
+    TLBPolicy tlbPolicy = TLB_FIFO;   // TLB replacement policy.
+    unsigned pageoutLow  = NUM_PHYS_PAGES / 16;  // Free frames that wake up
+    unsigned pageoutHigh = NUM_PHYS_PAGES / 8;   // the pageout daemon, and
+                                                 // that it leaves.
+    unsigned loadHigh = 10;  // Page faults per thousand instructions that
+    unsigned loadLow  = 2;   // suspend and resume programs.
+#endif
 #ifdef FILESYS_NEEDED
     bool format = false;  // Format disk.
 #endif
+#ifdef FILESYS
+    DirectoryFormat dirFormat = LINEAR_DIRECTORY;  // Layout of directories.
+#endif
 #ifdef NETWORK
     double rely = 1;  // Network reliability.
     int netname = 0;  // UNIX socket name.
@@ -152,10 +190,74 @@ Initialize(int argc, char **argv)
         if (!strcmp(*argv, "-s"))
             debugUserProg = true;
 #endif
+#ifdef USE_TLB
+        if (!strcmp(*argv, "-tlb")) {
+            ASSERT(argc > 1);
+            tlbSize = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tlbways")) {
+            ASSERT(argc > 1);
+            tlbWays = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tlbrep")) {
+            ASSERT(argc > 1);
+            const char *name = *(argv + 1);
+            if (!strcmp(name, "fifo"))
+                tlbPolicy = TLB_FIFO;
+            else if (!strcmp(name, "random"))
+                tlbPolicy = TLB_RANDOM;
+            else if (!strcmp(name, "lru"))
+                tlbPolicy = TLB_LRU;
+            else if (!strcmp(name, "clock"))
+                tlbPolicy = TLB_CLOCK;
+            else
+                ASSERT(false);  // Unknown TLB replacement policy.
+            argCount = 2;
+        } else if (!strcmp(*argv, "-pageout")) {
+            ASSERT(argc > 2);
+            pageoutLow  = atoi(*(argv + 1));
+            pageoutHigh = atoi(*(argv + 2));
+            argCount = 3;
+        } else if (!strcmp(*argv, "-loadctl")) {
+            ASSERT(argc > 2);
+            loadHigh = atoi(*(argv + 1));
+            loadLow  = atoi(*(argv + 2));
+            argCount = 3;
+        }
+#endif
+#ifdef VMEM
+        if (!strcmp(*argv, "-pagerep")) {
+            ASSERT(argc > 1);
+            const char *name = *(argv + 1);
+            if (!strcmp(name, "fifo"))
+                pagePolicy = PAGE_FIFO;
+            else if (!strcmp(name, "clock"))
+                pagePolicy = PAGE_CLOCK;
+            else if (!strcmp(name, "esc"))
+                pagePolicy = PAGE_ESC;
+            else if (!strcmp(name, "aging"))
+                pagePolicy = PAGE_AGING;
+            else if (!strcmp(name, "wsclock"))
+                pagePolicy = PAGE_WSCLOCK;
+            else
+                ASSERT(false);  // Unknown page replacement policy.
+            argCount = 2;
+        } else if (!strcmp(*argv, "-swapcache")) {
+            ASSERT(argc > 1);
+            swapCacheSize = atoi(*(argv + 1));
+            argCount = 2;
+        }
+#endif
 #ifdef FILESYS_NEEDED
         if (!strcmp(*argv, "-f"))
             format = true;
 #endif
+#ifdef FILESYS
+        if (!strcmp(*argv, "-fb")) {
+            format = true;
+            dirFormat = BTREE_DIRECTORY;
+        }
+#endif
 #ifdef NETWORK
         if (!strcmp(*argv, "-n")) {
             ASSERT(argc > 1);
@@ -198,17 +300,48 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
     Debugger *d = debugUserProg ? new Debugger : nullptr;
     machine = new Machine(d);  // This must come first.
+#ifdef USE_TLB
+    // An instruction may need the translation of its own address and the
+    // one of the data it reads or writes at the same time.  With a single
+    // way both pages can fall in the same set and evict each other
+    // forever, so a direct-mapped TLB is refused.
+    if (tlbWays == 0)
+        tlbWays = tlbSize;
+    if (tlbWays < 2 || tlbWays > tlbSize || tlbSize % tlbWays != 0) {
+        fprintf(stderr, "ERROR: `-tlbways %u` is not valid for a TLB of"
+                        " %u entries; the number of ways must be at least"
+                        " 2 and divide the number of entries.\n",
+                tlbWays, tlbSize);
+        exit(1);
+    }
+    machine->GetMMU()->ConfigureTLB(tlbSize, tlbWays, tlbPolicy);
+#endif
     // synchConsole = new SynchConsole();
     freeMemMap = new Bitmap(NUM_PHYS_PAGES);
+#ifdef VMEM
+    coreMap = new CoreMap(NUM_PHYS_PAGES, pagePolicy);
+    swapArea = new SwapArea("SWAP", swapCacheSize);
+#endif
+#ifdef USE_TLB
+    if (pageoutLow > 0)
+        coreMap->StartPageout(pageoutLow, pageoutHigh);
+    if (loadHigh > 0) {
+        loadControl = new LoadControl(NUM_PHYS_PAGES, loadHigh, loadLow);
+        loadControl->Start();
+    }
+#endif
     SetExceptionHandlers();
 #endif
 
 #ifdef FILESYS
     synchDisk = new SynchDisk("DISK");
     files = new FileTable();
+    freeMapLock = new Lock("free map");
 #endif
 
-#ifdef FILESYS_NEEDED
+#ifdef FILESYS
+    fileSystem = new FileSystem(format, dirFormat);
+#elif defined(FILESYS_NEEDED)
     fileSystem = new FileSystem(format);
 #endif
 
@@ -234,6 +367,13 @@ Cleanup()
     delete machine;
     delete synchConsole;
     delete freeMemMap;
+#ifdef VMEM
+    delete coreMap;
+    delete swapArea;
+#endif
+#ifdef USE_TLB
+    delete loadControl;
+#endif
     delete processTable;
 #endif
 
@@ -21,6 +21,9 @@
 #include "filesys/fs_synch.hh"
 
 class Bitmap;
+class CoreMap;
+class SwapArea;
+class LoadControl;
 
 /// Initialization and cleanup routines.
 
@@ -44,6 +47,11 @@ extern SynchConsole *synchConsole;
 extern Table<Thread*> *processTable;
 extern Bitmap *freeMemMap;
 extern Machine *machine;  // User program memory and registers.
+#ifdef VMEM
+extern CoreMap *coreMap;  ///< Owner of every physical frame.
+extern SwapArea *swapArea;  ///< Where pages go when they leave memory.
+extern LoadControl *loadControl;  ///< Medium-term scheduler, or null.
+#endif
 
 #endif
 
@@ -56,6 +64,8 @@ extern FileSystem *fileSystem;
 #include "filesys/synch_disk.hh"
 extern SynchDisk *synchDisk;
 extern FileTable *files;
+extern Lock *freeMapLock;  ///< Held while reading, changing and writing back
+                           ///< the bitmap of free sectors.
 #endif
 
 #ifdef NETWORK
@@ -0,0 +1,59 @@
+/// Lists the files in the directories specified on the command line, or in
+/// the current directory if none is given.
+
+#include "syscall.h"
+
+#define OPEN_ERROR     "Error: could not open directory.\n"
+#define READDIR_ERROR  "Error: not a directory.\n"
+#define BUFFER_SIZE    64
+
+static unsigned
+StringLength(const char *s)
+{
+    unsigned n = 0;
+    while (s[n] != '\0')
+        n++;
+    return n;
+}
+
+static int
+ListDirectory(const char *name)
+{
+    OpenFileId dir = Open(name);
+    if (dir < 2) {
+        Write(OPEN_ERROR, sizeof(OPEN_ERROR) - 1, CONSOLE_OUTPUT);
+        return 0;
+    }
+
+    // Names come packed, a batch at a time; the kernel never has to hold
+    // the whole directory.
+    char buffer[BUFFER_SIZE];
+    int cookie = 0, length;
+    while ((length = ReadDir(dir, buffer, BUFFER_SIZE, &cookie)) > 0)
+        for (int i = 0; i < length; ) {
+            unsigned n = StringLength(&buffer[i]);
+            Write(&buffer[i], n, CONSOLE_OUTPUT);
+            Write("\n", 1, CONSOLE_OUTPUT);
+            i += n + 1;
+        }
+    Close(dir);
+
+    if (length < 0) {
+        Write(READDIR_ERROR, sizeof(READDIR_ERROR) - 1, CONSOLE_OUTPUT);
+        return 0;
+    }
+    return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2)
+        return !ListDirectory(".");
+
+    int success = 1;
+    for (int i = 1; i < argc; i++)
+        if (!ListDirectory(argv[i]))
+            success = 0;
+    return !success;
+}
@@ -0,0 +1,128 @@
+/// A small memory allocator for user programs, built on `Sbrk`.
+///
+/// The heap is a sequence of blocks, each one after a header with its size
+/// and whether it is free, kept in a list in address order.  `malloc`
+/// takes the first free block that fits, splitting it if it is much
+/// larger; `free` merges a block with the free blocks next to it.  When no
+/// block fits, the heap grows with `Sbrk`, at least `MALLOC_CHUNK` bytes at
+/// a time, so that small requests do not trap into the kernel every time.
+
+#include "syscall.h"
+#include "malloc.h"
+
+
+#define ALIGNMENT     8
+#define MALLOC_CHUNK  512
+
+typedef struct Block {
+    unsigned size;        // Bytes after the header.
+    int free;
+    struct Block *next;   // Next block in address order, or null.
+} Block;
+
+#define HEADER_SIZE  ((sizeof(Block) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+static Block *first = 0;
+static Block *last  = 0;
+
+static unsigned
+Align(unsigned n)
+{
+    return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+/// Join `b` with the block after it, which must be free.
+static void
+Merge(Block *b)
+{
+    Block *next = b->next;
+    b->size += HEADER_SIZE + next->size;
+    b->next  = next->next;
+    if (last == next)
+        last = b;
+}
+
+/// Leave in `b` only `size` bytes, if the rest is enough for another block.
+static void
+Split(Block *b, unsigned size)
+{
+    if (b->size < size + HEADER_SIZE + ALIGNMENT)
+        return;
+    Block *rest = (Block *) ((char *) b + HEADER_SIZE + size);
+    rest->size = b->size - size - HEADER_SIZE;
+    rest->free = 1;
+    rest->next = b->next;
+    b->size = size;
+    b->next = rest;
+    if (last == b)
+        last = rest;
+}
+
+/// Grow the heap so that its last block is free and holds `size` bytes,
+/// and return that block, or null if there is no room.
+static Block *
+Grow(unsigned size)
+{
+    int extend = last != 0 && last->free;
+    unsigned bytes = extend ? size - last->size : size + HEADER_SIZE;
+    int address = -1;
+    if (bytes < MALLOC_CHUNK)
+        address = Sbrk(MALLOC_CHUNK);
+    if (address == -1)
+        address = Sbrk(bytes);
+    else
+        bytes = MALLOC_CHUNK;
+    if (address == -1)
+        return 0;
+
+    if (extend) {
+        last->size += bytes;
+        return last;
+    }
+    Block *b = (Block *) address;
+    b->size = bytes - HEADER_SIZE;
+    b->free = 1;
+    b->next = 0;
+    if (last != 0)
+        last->next = b;
+    else
+        first = b;
+    last = b;
+    return b;
+}
+
+void *
+malloc(unsigned size)
+{
+    if (size == 0)
+        return 0;
+    size = Align(size);
+
+    Block *b;
+    for (b = first; b != 0; b = b->next)
+        if (b->free && b->size >= size)
+            break;
+    if (b == 0 && (b = Grow(size)) == 0)
+        return 0;
+
+    Split(b, size);
+    b->free = 0;
+    return (char *) b + HEADER_SIZE;
+}
+
+void
+free(void *ptr)
+{
+    if (ptr == 0)
+        return;
+
+    Block *b = (Block *) ((char *) ptr - HEADER_SIZE);
+    b->free = 1;
+    if (b->next != 0 && b->next->free)
+        Merge(b);
+
+    Block *prev;
+    for (prev = first; prev != 0 && prev->next != b; prev = prev->next);
+    if (prev != 0 && prev->free)
+        Merge(prev);
+}
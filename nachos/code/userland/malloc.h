@@ -0,0 +1,19 @@
+/// A small memory allocator for user programs, built on `Sbrk`.
+///
+/// Programs that use it must be listed in `MALLOC_PROGRAMS` in the
+/// `Makefile`, so that they are linked with `malloc.o`.
+
+#ifndef NACHOS_USERLAND_MALLOC__H
+#define NACHOS_USERLAND_MALLOC__H
+
+
+/// Return a block of at least `size` bytes, aligned to 8 bytes, or null if
+/// `size` is 0 or the heap can not grow.  Its contents are undefined.
+void *malloc(unsigned size);
+
+/// Give back the block at `ptr`, returned by `malloc`.  Nothing happens if
+/// `ptr` is null.
+void free(void *ptr);
+
+
+#endif
@@ -0,0 +1,44 @@
+/// Benchmark for the TLB: spins over a single page of data.
+///
+/// Usage: `mspin [<passes>]`.  Adds to every word of a 128-byte array,
+/// `passes` times (by default 200), so that besides its code the program
+/// only touches that one data page.  Several copies at once, started with
+/// `spawn`, show how TLB entries survive context switches:
+///
+///     vmem/nachos -x userland/spawn 2 userland/mspin
+///     vmem/nachos -x userland/spawn 3 userland/mspin
+///
+/// The TLB options, such as `-tlb 8 -tlbways 2 -tlbrep clock`, go before
+/// `-x`.
+
+#include "syscall.h"
+
+
+#define PAGE_BYTES  128
+
+static int data[PAGE_BYTES / sizeof (int)];
+
+static int
+ParseNumber(const char *s)
+{
+    int n = 0;
+    for (; *s >= '0' && *s <= '9'; s++)
+        n = n * 10 + *s - '0';
+    return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int passes = argc > 1 ? ParseNumber(argv[1]) : 200;
+    int words  = sizeof data / sizeof data[0];
+
+    int sum = 0;
+    for (int p = 0; p < passes; p++)
+        for (int i = 0; i < words; i++) {
+            data[i] += i;
+            sum += data[i];
+        }
+
+    Exit(sum);
+}
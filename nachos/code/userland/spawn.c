@@ -0,0 +1,52 @@
+/// Runs several copies of a program at once, for benchmarks.
+///
+/// Usage: `spawn <copies> <program> [<args>...]`.  Starts `copies`
+/// processes running `program` with the arguments given, and waits until
+/// all of them finish.  For example, three processes with 40-page working
+/// sets on the 16 frames of the vmem build:
+///
+///     vmem/nachos -x userland/spawn 3 userland/workset 40
+
+#include "syscall.h"
+
+
+#define MAX_COPIES  16
+#define USAGE       "Usage: spawn <copies> <program> [<args>...]\n"
+#define EXEC_FAILED "Error: could not start the program.\n"
+
+static int
+ParseNumber(const char *s)
+{
+    int n = 0;
+    for (; *s >= '0' && *s <= '9'; s++)
+        n = n * 10 + *s - '0';
+    return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        Write(USAGE, sizeof USAGE - 1, CONSOLE_OUTPUT);
+        Exit(1);
+    }
+    int copies = ParseNumber(argv[1]);
+    if (copies > MAX_COPIES)
+        copies = MAX_COPIES;
+
+    // The program sees its own name as `argv[0]`, as from the shell.
+    SpaceId children[MAX_COPIES];
+    int started = 0;
+    for (; started < copies; started++) {
+        children[started] = Exec(argv[2], &argv[2], 1);
+        if (children[started] < 0) {
+            Write(EXEC_FAILED, sizeof EXEC_FAILED - 1, CONSOLE_OUTPUT);
+            break;
+        }
+    }
+
+    int status = 0;
+    for (int i = 0; i < started; i++)
+        status |= Join(children[i]);
+    Exit(started == copies ? status : 1);
+}
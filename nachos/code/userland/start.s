@@ -133,6 +133,46 @@ Close:
         j       $31
         .end    Close
 
+        .globl  ReadDir
+        .ent    ReadDir
+ReadDir:
+        addiu   $2, $0, SC_READDIR
+        syscall
+        j       $31
+        .end    ReadDir
+
+        .globl  Mmap
+        .ent    Mmap
+Mmap:
+        addiu   $2, $0, SC_MMAP
+        syscall
+        j       $31
+        .end    Mmap
+
+        .globl  Munmap
+        .ent    Munmap
+Munmap:
+        addiu   $2, $0, SC_MUNMAP
+        syscall
+        j       $31
+        .end    Munmap
+
+        .globl  Sbrk
+        .ent    Sbrk
+Sbrk:
+        addiu   $2, $0, SC_SBRK
+        syscall
+        j       $31
+        .end    Sbrk
+
+        .globl  GetPagingStats
+        .ent    GetPagingStats
+GetPagingStats:
+        addiu   $2, $0, SC_PAGINGSTATS
+        syscall
+        j       $31
+        .end    GetPagingStats
+
 /// Dummy function to keep gcc happy.
         .globl  __main
         .ent    __main
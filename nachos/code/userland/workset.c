@@ -0,0 +1,50 @@
+/// Benchmark for virtual memory with a working set chosen at run time.
+///
+/// Usage: `workset <pages> [<passes>]`.  Allocates `pages` pages of 128
+/// bytes on the heap and writes every word of them, `passes` times (by
+/// default 10), so that the program uses exactly that many data pages.
+
+#include "syscall.h"
+#include "malloc.h"
+
+
+#define PAGE_BYTES  128
+#define USAGE       "Usage: workset <pages> [<passes>]\n"
+#define NO_MEMORY   "Error: not enough memory.\n"
+
+static int
+ParseNumber(const char *s)
+{
+    int n = 0;
+    for (; *s >= '0' && *s <= '9'; s++)
+        n = n * 10 + *s - '0';
+    return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        Write(USAGE, sizeof USAGE - 1, CONSOLE_OUTPUT);
+        Exit(1);
+    }
+    int pages  = ParseNumber(argv[1]);
+    int passes = argc > 2 ? ParseNumber(argv[2]) : 10;
+    int words  = pages * PAGE_BYTES / sizeof (int);
+
+    int *data = malloc(pages * PAGE_BYTES);
+    if (data == 0) {
+        Write(NO_MEMORY, sizeof NO_MEMORY - 1, CONSOLE_OUTPUT);
+        Exit(1);
+    }
+
+    int sum = 0;
+    for (int p = 0; p < passes; p++)
+        for (int i = 0; i < words; i++) {
+            data[i] += i;
+            sum += data[i];
+        }
+
+    free(data);
+    Exit(sum);
+}
@@ -8,7 +8,13 @@
 
 #include "address_space.hh"
 #include "threads/system.hh"
+#include "threads/synch.hh"
 #include "lib/bitmap.hh"
+#ifdef VMEM
+#include "vmem/core_map.hh"
+#include "vmem/load_control.hh"
+#include "vmem/swap_area.hh"
+#endif
 #include <string.h>
 #include <stdio.h>
 	
@@ -31,6 +37,23 @@ VirtualToPhysical(unsigned virtualAddr, TranslationEntry *pageTable){
     return frame * PAGE_SIZE + offset;
 }
 
+#ifndef VMEM
+/* Copia `size` bytes de `data`, leidos de un segmento del ejecutable, a partir
+   de la direccion virtual `virtualAddr`.  Las paginas virtuales consecutivas no
+   estan en marcos consecutivos, asi que se copia de a un pedazo de pagina por
+   vez. */
+static void
+CopyToFrames(const char *data, uint32_t size, uint32_t virtualAddr, TranslationEntry *pageTable){
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    uint32_t copied = 0;
+    while (copied < size) {
+        uint32_t chunk = min(size - copied, PAGE_SIZE - (virtualAddr + copied) % PAGE_SIZE);
+        memcpy(&mainMemory[VirtualToPhysical(virtualAddr + copied, pageTable)], &data[copied], chunk);
+        copied += chunk;
+    }
+}
+#endif
+
 /* Inicializa un espacio de direcciones para un proceso. 
    - Inicializa tabla de paginas
    - Segun si:
@@ -38,6 +61,9 @@ VirtualToPhysical(unsigned virtualAddr, TranslationEntry *pageTable){
         - Si esta definida VMEM, se utiliza paginacion por demanda por lo que todas las paginas del nuevo proceso
             comienzan apuntando al número de paginas + 1 e invalidas. Además crea el archivo de swap asociado a este proceso. */
 AddressSpace::AddressSpace(OpenFile *executable_file, int id)
+#ifdef USE_TLB
+    : pageTable(id)
+#endif
 {
     ASSERT(executable_file != nullptr);
 
@@ -45,53 +71,94 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int id)
     ASSERT(exe->CheckMagic());
 
     asid = id;
+    paging = PagingStats();
+    #ifdef USE_TLB
+    exeFile = executable_file->GetSector();
+    pendingEvictions = 0;
+    workingSet = 0;
+    tablesToReclaim = false;
+    complete = true;
+    #endif
 
     // How big is address space?
     unsigned size = exe->GetSize() + USER_STACK_SIZE;
       // We need to increase the size to leave room for the stack.
     numPages = DivRoundUp(size, PAGE_SIZE);
     size = numPages * PAGE_SIZE;
+    #ifdef USE_TLB
+    // Files mapped with `Mmap` go after the stack, in pages reserved now.
+    // Their second-level page tables are only created if they are used.
+    mmapFirstPage = numPages;
+    numPages += MMAP_PAGES;
+    #endif
+    // The heap comes last, and starts empty.
+    heapFirstPage = numPages;
+    heapBreak = numPages * PAGE_SIZE;
 
     // Check we are not trying to run anything too big -- at least until we
     // have virtual memory.
 
     #ifndef VMEM
     ASSERT(numPages <= freeMemMap->CountClear());  
-    #else
-    DEBUG('a', "Initializing address space swap file. ASID: %d\n",asid);
-    char swapFileName[16];
-    snprintf(swapFileName, 16, "SWAP.%d", asid);
-    
-    fileSystem->Create(swapFileName, asid);
-    swapFile = fileSystem->Open(swapFileName);
     #endif  
 
     DEBUG('a', "Initializing address space, num pages %u, size %u\n",
           numPages, size);
 
-    // First, set up the translation.
+    // First, set up the translation.  With demand paging, the second-level
+    // tables are created as pages are loaded.
+    #ifdef USE_TLB
+    pageTable.Resize(numPages);
+    #else
     pageTable = new TranslationEntry[numPages];
     for (unsigned i = 0; i < numPages; i++) {
         pageTable[i].virtualPage  = i;
-        #ifndef USE_TLB
         pageTable[i].physicalPage = freeMemMap->Find();
         pageTable[i].valid        = true;
-        #else
-        pageTable[i].physicalPage = numPages + 1;
-        pageTable[i].valid        = false;
-        #endif
         pageTable[i].use          = false;
         pageTable[i].dirty        = false;
+        pageTable[i].asid         = asid;
         pageTable[i].readOnly     = false;
-        // If the code segment was entirely on a separate page, we could
-        // set its pages to be read-only.
     }
+    #endif
+    #ifdef USE_TLB
+    swapSlot = new int [numPages];
+    evicting = new bool [numPages];
+    mapping = new MappedFile *[numPages];
+    pageState = new PageState [numPages];
+    lastUse = new unsigned long [numPages];
+    evictionLock = new Lock("eviction");
+    evictionDone = new Condition("eviction done", evictionLock);
+    // Pages that no segment of the executable touches, the stack and most
+    // of the uninitialized data, start as zeroes.
+    unsigned codeEnd = exe->GetCodeAddr() + exe->GetCodeSize();
+    unsigned dataEnd = exe->GetInitDataAddr() + exe->GetInitDataSize();
+    for (unsigned i = 0; i < numPages; i++) {
+        unsigned first = i * PAGE_SIZE, end = (i + 1) * PAGE_SIZE;
+        bool inCode = exe->GetCodeSize() > 0
+                      && first < codeEnd && end > exe->GetCodeAddr();
+        bool inData = exe->GetInitDataSize() > 0
+                      && first < dataEnd && end > exe->GetInitDataAddr();
+        swapSlot[i] = -1;
+        evicting[i] = false;
+        mapping[i] = nullptr;
+        pageState[i] = inCode || inData ? PAGE_IN_EXECUTABLE : PAGE_ZERO_FILL;
+        lastUse[i] = 0;
+    }
+    #endif
 
     DEBUG('a', "Page table initialized succesfully.\n");
     
-    // Then, copy in the code and data segments into memory.
+    // Then, copy in the code and data segments into memory.  Each segment
+    // is read from the executable in a single transfer, so every sector is
+    // read once, and then split among the frames of its pages.  Frames may
+    // still hold the pages of a previous process, and whatever the
+    // segments do not cover (uninitialized data and stack) must start zeroed.
     #ifndef VMEM
-    char *mainMemory = machine->GetMMU()->mainMemory;  
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    for (unsigned i = 0; i < numPages; i++)
+        memset(&mainMemory[pageTable[i].physicalPage * PAGE_SIZE], 0, PAGE_SIZE);
+
     uint32_t codeSize = exe->GetCodeSize();
     uint32_t initDataSize = exe->GetInitDataSize();
     if (codeSize > 0) {
@@ -99,26 +166,142 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int id)
         DEBUG('a', "Initializing code segment, at 0x%X, size %u\n",
               virtualAddr, codeSize);
 
-        unsigned realAddr;
-        for(unsigned codeByte = 0; codeByte < codeSize; codeByte++){
-          realAddr = VirtualToPhysical(virtualAddr+codeByte,pageTable);
-          exe->ReadCodeBlock(&(mainMemory[realAddr]), 1, codeByte);
-        }
+        char *segment = new char [codeSize];
+        exe->ReadCodeBlock(segment, codeSize, 0);
+        CopyToFrames(segment, codeSize, virtualAddr, pageTable);
+        delete [] segment;
     }
     if (initDataSize > 0) {
         uint32_t virtualAddr = exe->GetInitDataAddr();
         DEBUG('a', "Initializing data segment, at 0x%X, size %u\n",
               virtualAddr, initDataSize);
-        
-        unsigned realAddr;
-        for(unsigned codeByte = 0; codeByte < initDataSize; codeByte++){
-          realAddr = VirtualToPhysical(virtualAddr+codeByte,pageTable);
-          exe->ReadDataBlock(&(mainMemory[realAddr]), 1, codeByte);
-        }
+
+        char *segment = new char [initDataSize];
+        exe->ReadDataBlock(segment, initDataSize, 0);
+        CopyToFrames(segment, initDataSize, virtualAddr, pageTable);
+        delete [] segment;
     }
     #endif
 }
 
+#ifdef USE_TLB
+/* Crea el espacio de direcciones de un proceso hijo, copia del de `parent`,
+   para `Fork`.  Las paginas que el padre tiene en memoria no se copian: pasan a
+   estar compartidas entre ambos y de solo lectura, y se copian recien cuando
+   alguno de los dos las escribe (ver `CopyOnWrite`).  Las paginas que el padre
+   tiene en swap se copian a slots nuevos para el hijo; las que nunca cargo se
+   leeran del ejecutable.  Los archivos mapeados no se heredan.
+
+   Una pagina compartida que el hijo no podria volver a leer igual de su
+   ejecutable queda `PAGE_SWAP_STALE` para el: debe guardarla en su swap si se
+   desaloja.  Al padre le pasa lo mismo solo si la habia modificado.
+
+   Si el swap se llena, el resto de las paginas que el padre tiene en swap no se
+   copian y la copia queda incompleta: quien la pidio debe destruirla. */
+AddressSpace::AddressSpace(AddressSpace *parent, int id)
+    : pageTable(id)
+{
+    ASSERT(parent != nullptr);
+
+    exe = new Executable(*parent->exe);
+    asid = id;
+    paging = PagingStats();
+    exeFile = parent->exeFile;
+    numPages = parent->numPages;
+    mmapFirstPage = parent->mmapFirstPage;
+    heapFirstPage = parent->heapFirstPage;
+    heapBreak = parent->heapBreak;
+    pendingEvictions = 0;
+    workingSet = 0;
+    tablesToReclaim = false;
+    complete = true;
+
+    DEBUG('a', "Copying address space %d, num pages %u\n", parent->asid, numPages);
+
+    // The use and dirty bits of the parent are needed to know which shared
+    // pages have to be saved if they are evicted.
+    parent->SaveState();
+
+    pageTable.Resize(numPages);
+    swapSlot = new int [numPages];
+    evicting = new bool [numPages];
+    mapping = new MappedFile *[numPages];
+    pageState = new PageState [numPages];
+    lastUse = new unsigned long [numPages];
+    evictionLock = new Lock("eviction");
+    evictionDone = new Condition("eviction done", evictionLock);
+    // Not in the stack, as in `WriteCluster`.
+    char *page = new char [PAGE_SIZE];
+    for (unsigned i = 0; i < numPages; i++) {
+        // A page of the parent that is being evicted is neither in memory
+        // nor completely in swap yet.  Copying the previous pages may have
+        // given the pageout daemon time to pick it.
+        parent->WaitForPage(i);
+
+        swapSlot[i] = -1;
+        evicting[i] = false;
+        mapping[i] = nullptr;
+        pageState[i] = parent->pageState[i];
+        lastUse[i] = 0;
+
+        // Only the pages in memory need an entry in the child.
+        if (parent->mapping[i] != nullptr)
+            continue;
+        if (!parent->pageTable.IsValid(i)) {
+            if (parent->pageState[i] == PAGE_IN_SWAP && complete) {
+                int slot = GetSwapSlot(i);
+                if (slot < 0) {
+                    DEBUG('a', "Out of swap copying page %u.\n", i);
+                    complete = false;
+                    continue;
+                }
+                swapArea->ReadPage(parent->swapSlot[i], page);
+                swapArea->WritePage(slot, page);
+            }
+            continue;
+        }
+        pageTable[i] = parent->pageTable[i];
+        pageTable[i].asid = asid;
+        pageTable[i].use = false;
+        pageTable[i].dirty = false;
+
+        unsigned ppn = parent->pageTable[i].physicalPage;
+        // Both keep mapping the frame of zeroes until they write the page.
+        if (coreMap->IsZeroFrame(ppn))
+            continue;
+        if (!coreMap->IsShared(ppn)) {
+            // From now on the frame is written through `CopyOnWrite` only,
+            // so the dirty bit of the parent is moved to its state.
+            bool dirty = parent->pageTable[i].dirty;
+            if (dirty)
+                parent->pageState[i] = PAGE_SWAP_STALE;
+            coreMap->Share(ppn);
+            coreMap->GetPage(ppn)->dirty = false;
+            parent->pageTable[i].readOnly = true;
+            pageTable[i].readOnly = true;
+        }
+        coreMap->AddSharer(ppn, this);
+        // The child has no copy in swap of its own yet.
+        if (parent->pageState[i] != PAGE_IN_EXECUTABLE
+              && parent->pageState[i] != PAGE_ZERO_FILL)
+            pageState[i] = PAGE_SWAP_STALE;
+    }
+    delete [] page;
+
+    // The entries of the parent in the TLB may still allow writing the
+    // pages that are now shared.
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for (unsigned i = 0; i < machine->GetMMU()->GetTLBSize(); i++)
+        if (tlb[i].valid && tlb[i].asid == (unsigned) parent->asid)
+            tlb[i].valid = false;
+}
+
+bool
+AddressSpace::IsComplete() const{
+    return complete;
+}
+#endif
+
 
 /* Libera la tabla de páginas y los espacios reservados del freeMemMap que refieren a las paginas liberadas. */ 
 
@@ -126,11 +309,25 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int id)
 /// Clear freeMemMap.
 AddressSpace::~AddressSpace()
 {
+    #ifdef USE_TLB
+    ReleaseFrames();
+    ReleaseSwap();
+    #else
     for (unsigned i = 0; i < numPages; i++) 
         if (pageTable[i].valid)
             freeMemMap->Clear(pageTable[i].physicalPage);
-        
     delete [] pageTable;
+    #endif
+        
+    #ifdef USE_TLB
+    delete [] swapSlot;
+    delete [] evicting;
+    delete [] mapping;
+    delete [] pageState;
+    delete [] lastUse;
+    delete evictionDone;
+    delete evictionLock;
+    #endif
     delete exe;
 }
 
@@ -156,15 +353,20 @@ AddressSpace::InitRegisters()
 
     // Set the stack register to the end of the address space, where we
     // allocated the stack; but subtract off a bit, to make sure we do not
-    // accidentally reference off the end!
-
-    machine->WriteRegister(STACK_REG, numPages * PAGE_SIZE - 16);
-    DEBUG('a', "Initializing stack register to %u\n",
-          numPages * PAGE_SIZE - 16);
+    // accidentally reference off the end!  With demand paging, the area of
+    // mapped files comes after it.
+    #ifdef USE_TLB
+    unsigned stackEnd = mmapFirstPage * PAGE_SIZE;
+    #else
+    unsigned stackEnd = heapFirstPage * PAGE_SIZE;
+    #endif
+    machine->WriteRegister(STACK_REG, stackEnd - 16);
+    DEBUG('a', "Initializing stack register to %u\n", stackEnd - 16);
 }
 
 
-/* Al realizarse un cambio de contexto, se copia el estado de las paginas de la tlb validas a la tabla de paginas del proceso. */
+/* Al realizarse un cambio de contexto, se copia el estado de las paginas de la
+   tlb validas que pertenecen al proceso a su tabla de paginas. */
 /// On a context switch, save any machine state, specific to this address
 /// space, that needs saving.
 ///
@@ -173,17 +375,20 @@ AddressSpace::SaveState()
 {
   #ifdef USE_TLB
    TranslationEntry tlbEntry;
-    for (unsigned i = 0; i < TLB_SIZE; i++) {
+    for (unsigned i = 0; i < machine->GetMMU()->GetTLBSize(); i++) {
         tlbEntry = machine->GetMMU()->tlb[i];
-        if (tlbEntry.valid) {
+        if (tlbEntry.valid && tlbEntry.asid == (unsigned) asid) {
             pageTable[tlbEntry.virtualPage] = tlbEntry;
         }
    }
   #endif
 }
 
-/* Cuando un proceso retorna de un cambio de contexto, las paginas de la TLB le corresponden al proceso que se ejecutaba anteriormente, por
-   lo que se deben invalidar las paginas de la TLB, resultando que se vuelvan a cargar de ser necesario. */
+/* Cuando un proceso retorna de un cambio de contexto, la TLB puede tener
+   paginas de otros procesos.  Como cada entrada lleva el identificador de su
+   espacio de direcciones, basta con indicarle a la MMU cual es el actual: las
+   entradas del proceso que sigan en la TLB se vuelven a usar sin fallos, y las
+   ajenas se ignoran. */
 
 /// On a context switch, restore the machine state so that this address space
 /// can run.
@@ -193,23 +398,219 @@ void
 AddressSpace::RestoreState()
 {
     #ifdef USE_TLB
-    for(unsigned int i=0; i<TLB_SIZE; i++) machine->GetMMU()->tlb[i].valid = false;    
+    machine->GetMMU()->asid = asid;
     #else
     machine->GetMMU()->pageTable     = pageTable;
     machine->GetMMU()->pageTableSize = numPages;
     #endif
 }
 
+/* Mueve el final del heap.  Si pasa a otra pagina, la tabla se agranda hasta
+   ella; el heap no puede pasar de `USER_HEAP_MAX_SIZE` bytes, ni, sin memoria
+   virtual, de los marcos libres. */
+int
+AddressSpace::Sbrk(unsigned increment){
+    unsigned old = heapBreak;
+    if (increment > USER_HEAP_MAX_SIZE - (old - heapFirstPage * PAGE_SIZE))
+        return -1;
+
+    unsigned pages = DivRoundUp(old + increment, PAGE_SIZE);
+    if (pages > numPages) {
+        #ifndef USE_TLB
+        if (pages - numPages > freeMemMap->CountClear())
+            return -1;
+        #endif
+        Grow(pages);
+        // The machine may be using the old page table.
+        RestoreState();
+    }
+    heapBreak = old + increment;
+    DEBUG('a', "Heap of address space %d ends at %u, num pages %u\n",
+          asid, heapBreak, numPages);
+    return old;
+}
+
+/* Devuelve una copia de `array`, de `size` elementos, agrandada a `newSize` con
+   `value` en los nuevos, y libera el original. */
+template <class T>
+static T *
+Resize(T *array, unsigned size, unsigned newSize, T value){
+    T *resized = new T [newSize];
+    for (unsigned i = 0; i < size; i++)
+        resized[i] = array[i];
+    for (unsigned i = size; i < newSize; i++)
+        resized[i] = value;
+    delete [] array;
+    return resized;
+}
+
+/* Sin memoria virtual, las paginas nuevas se cargan enseguida en marcos libres,
+   en cero.  Con paginacion por demanda quedan invalidas y se llenan con ceros
+   recien cuando se usan; solo crece el directorio de la tabla de paginas, y las
+   tablas de segundo nivel, a las que apunta el mapa de memoria, quedan donde
+   estaban.  Nada de esto cede el procesador, asi que ningun otro hilo, como el
+   daemon de pageout, ve los arreglos a medio copiar. */
+void
+AddressSpace::Grow(unsigned pages){
+    ASSERT(pages > numPages);
+
+    #ifdef USE_TLB
+    pageTable.Resize(pages);
+    swapSlot  = Resize(swapSlot, numPages, pages, -1);
+    evicting  = Resize(evicting, numPages, pages, false);
+    mapping   = Resize(mapping, numPages, pages, (MappedFile *) nullptr);
+    pageState = Resize(pageState, numPages, pages, PAGE_ZERO_FILL);
+    lastUse   = Resize(lastUse, numPages, pages, 0UL);
+    #else
+    TranslationEntry *table = new TranslationEntry[pages];
+    for (unsigned i = 0; i < numPages; i++)
+        table[i] = pageTable[i];
+    for (unsigned i = numPages; i < pages; i++) {
+        table[i].virtualPage  = i;
+        table[i].physicalPage = freeMemMap->Find();
+        table[i].valid        = true;
+        memset(&machine->GetMMU()->mainMemory[table[i].physicalPage * PAGE_SIZE], 0, PAGE_SIZE);
+        table[i].use          = false;
+        table[i].dirty        = false;
+        table[i].readOnly     = false;
+        table[i].asid         = asid;
+    }
+    delete [] pageTable;
+    pageTable = table;
+    #endif
+    numPages  = pages;
+}
+
+PagingStats *
+AddressSpace::GetPagingStats(){
+    return &paging;
+}
+
+void
+AddressSpace::PrintPagingStats() const{
+    printf("Paging of address space %d: TLB misses %u, page faults %u, "
+           "swap-ins %u, swap-outs %u, zero fills %u, evictions %u\n",
+           asid, paging.tlbMisses, paging.pageFaults, paging.swapIns,
+           paging.swapOuts, paging.zeroFills, paging.evictions);
+}
+
+/* Con paginacion por demanda, cargar la pagina o darle un marco propio puede
+   ceder el procesador, y mientras tanto otro hilo puede desalojarla; por eso se
+   vuelve a mirar despues de cada paso, y el marco se fija recien cuando no hace
+   falta ninguno.  Los bits de uso y de modificacion se marcan tambien en la
+   TLB, porque `SaveState` copia sus entradas sobre la tabla de paginas.  Sin
+   memoria virtual, todas las paginas estan siempre en memoria. */
+int
+AddressSpace::PinPage(unsigned vpn, bool write){
+    #ifdef USE_TLB
+    if (!IsAddressable(vpn))
+        return -1;
+    for (;;) {
+        if (!pageTable.IsValid(vpn)) {
+            DEBUG('k',"Kernel transfer faults on page %u.\n", vpn);
+            if (loadControl != nullptr)
+                loadControl->PageFault(this);
+            stats->numPageFaults++;
+            paging.pageFaults++;
+            if (!LoadPage(vpn))
+                return -1;
+            continue;
+        }
+        if (write && pageTable[vpn].readOnly) {
+            if (!CopyOnWrite(vpn))
+                return -1;
+            continue;
+        }
+        break;
+    }
+
+    unsigned ppn = pageTable[vpn].physicalPage;
+    coreMap->Pin(ppn);
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for (unsigned i = 0; i < machine->GetMMU()->GetTLBSize(); i++)
+        if (tlb[i].valid && tlb[i].asid == (unsigned) asid && tlb[i].virtualPage == vpn) {
+            tlb[i].use = true;
+            tlb[i].dirty = tlb[i].dirty || write;
+        }
+    lastUse[vpn] = stats->totalTicks;
+    #else
+    if (vpn >= numPages)
+        return -1;
+    unsigned ppn = pageTable[vpn].physicalPage;
+    #endif
+    pageTable[vpn].use = true;
+    if (write)
+        pageTable[vpn].dirty = true;
+    return ppn;
+}
+
+void
+AddressSpace::UnpinPage(unsigned ppn){
+    #ifdef USE_TLB
+    coreMap->Unpin(ppn);
+    #endif
+}
+
 #ifdef USE_TLB
-/* Esta operacion es utilizada desde el manejador de fallos de paginas y dada una pagina virtual, devuelve la pagina fisica asociada al numero de
-   pagina virtual.
-   Si no hay mas espacio fisico, remueve una pagina utilizando `ClearPage` el cual dependiendo del algoritmo configurado selecciona una pagina victima.
-    
-   Luego dependiendo de si la pagina se encuentra en SWAP o no, la carga y la retorna.
-*/
-TranslationEntry 
+/* Esta operacion es utilizada desde el manejador de fallos de paginas y dada
+   una pagina virtual, devuelve la pagina fisica asociada al numero de pagina
+   virtual.  Normalmente el daemon de pageout mantiene marcos libres; si no hay
+   ninguno, el mapa de memoria elige una pagina victima, que se remueve de su
+   espacio de direcciones con `RemovePage`.
+
+   Luego se llena el marco con `FillFrame`.  El marco queda fijado mientras se
+   cargan las paginas vecinas con `FaultAround`, para que nadie lo desaloje
+   antes de que el manejador lo ponga en la TLB.
+
+   Una pagina que nunca se escribio y no esta en el ejecutable no usa ningun
+   marco: mapea el de ceros, que nunca se desaloja.
+
+   Si no hay marcos libres y no se puede desalojar ninguna pagina porque todas
+   deben guardarse y el swap esta lleno, la pagina no se carga. */
+bool
 AddressSpace::LoadPage(unsigned vpn){
+    ASSERT(vpn < numPages);
+
+    // If another thread, like the pageout daemon, is still saving the page,
+    // its copy in swap is not complete yet.
+    WaitForPage(vpn);
+    ReclaimTables();
+
+    // The use and dirty bits of the pages in the TLB are needed to choose a
+    // victim and to know whether it has to be saved.
+    SaveState();
 
+    int ppn = -1;
+    if(!MapZeroPage(vpn)){
+        ppn = MapSharedPage(vpn);
+        if(ppn < 0){
+            ppn = coreMap->FindOrEvict(this, &pageTable[vpn]);
+            if(ppn < 0){
+                DEBUG('k',"Out of swap loading page %u.\n", vpn);
+                return false;
+            }
+            FillFrame(vpn, ppn);
+            if(IsCodePage(vpn))
+                coreMap->MakeShared(ppn, exeFile, vpn);
+        }
+    }
+
+    // A fault is a reference, for the working set.
+    lastUse[vpn] = stats->totalTicks;
+
+    FaultAround(vpn);
+    if(ppn >= 0)
+        coreMap->Unpin(ppn);
+    DEBUG('k',"Page loaded succesfully. VPN: %d, PPN: %d\n",vpn,ppn);
+    return true;
+}
+
+/* Copia en el marco `ppn` el contenido de la pagina virtual `vpn`: desde su
+   archivo si esta mapeada, y si no segun su estado, desde su slot de swap, con
+   ceros, o desde los segmentos de codigo y datos del ejecutable, completando
+   con ceros.  La pagina queda valida y sin modificar. */
+void
+AddressSpace::FillFrame(unsigned vpn, unsigned ppn){
     // VPN correspone a la direccion virtual del proceso.
     unsigned codeSize = exe->GetCodeSize();
     unsigned dataSize = exe->GetInitDataSize();
@@ -219,123 +620,656 @@ AddressSpace::LoadPage(unsigned vpn){
     int sizeToRead, offset, remaining = PAGE_SIZE;
     unsigned virtualAddr = vpn * PAGE_SIZE;
 
-         
-    int ppn = freeMemMap->Find(this);
-    if(ppn < 0){
-        freeMemMap->ClearPage(this);
-        return LoadPage(vpn);
-    } else{
-        if(vpn < 0){
-            DEBUG('h',"Error: VPN < 0, finishing current thread.\n");
-            currentThread->Finish();
-        } else {
-                char *mainMemory = machine->GetMMU()->mainMemory;  
-                unsigned realAddr = ppn * PAGE_SIZE;
-            
-                SaveState();
-            
-            if(pageTable[vpn].dirty){
-                DEBUG('k',"Loading page from SWAP.\n");
-                swapFile->ReadAt(&(mainMemory[realAddr]), PAGE_SIZE, vpn * PAGE_SIZE);
-            } else {
-                // Code segment
-                if(virtualAddr < (codeSize+codeAddr)){
-                  DEBUG('k',"Code Page\n");
-                  sizeToRead = min(remaining,(int)((codeSize + codeAddr) - virtualAddr));
-                  offset = max(0,virtualAddr - codeAddr);
-                  exe->ReadCodeBlock(&mainMemory[realAddr], sizeToRead, offset);
-                  remaining -= sizeToRead;
-                  virtualAddr += sizeToRead;
-                }
+    char *mainMemory = machine->GetMMU()->mainMemory;  
+    unsigned realAddr = ppn * PAGE_SIZE;
 
-                // Data segment
-                if((virtualAddr < dataSize+dataAddr) && (remaining>0) && (dataSize)){
-                  DEBUG('k',"Data Page\n");
-                  sizeToRead = min(remaining, (dataSize + dataAddr) - virtualAddr);
-                  offset = max(0,virtualAddr - dataAddr);
-                  exe->ReadDataBlock(&mainMemory[realAddr + (PAGE_SIZE - remaining)],sizeToRead,offset);
-                  remaining -= sizeToRead;
-                  virtualAddr += sizeToRead;
-                }
+    stats->numPagesLoaded++;
+    if(mapping[vpn] != nullptr){
+        DEBUG('k',"Loading page from its mapped file.\n");
+        ReadMappedPage(vpn, &mainMemory[realAddr]);
+    } else if(pageState[vpn] == PAGE_IN_SWAP){
+        DEBUG('k',"Loading page from swap slot %d.\n", swapSlot[vpn]);
+        stats->numSwapReads++;
+        paging.swapIns++;
+        swapArea->ReadPage(swapSlot[vpn], &mainMemory[realAddr]);
+    } else if(pageState[vpn] == PAGE_ZERO_FILL){
+        DEBUG('k',"Zero-fill Page\n");
+        paging.zeroFills++;
+        memset(&mainMemory[realAddr], 0, PAGE_SIZE);
+    } else {
+        // A stale page is always in memory.
+        ASSERT(pageState[vpn] == PAGE_IN_EXECUTABLE);
+        // Code segment
+        if(virtualAddr < (codeSize+codeAddr)){
+          DEBUG('k',"Code Page\n");
+          sizeToRead = min(remaining,(int)((codeSize + codeAddr) - virtualAddr));
+          offset = max(0,virtualAddr - codeAddr);
+          exe->ReadCodeBlock(&mainMemory[realAddr], sizeToRead, offset);
+          remaining -= sizeToRead;
+          virtualAddr += sizeToRead;
+        }
 
-                // Stack segment
-                if(remaining>0){
-                  DEBUG('k',"Stack Page\n");
-                  memset(mainMemory + ((ppn+1) * PAGE_SIZE - remaining), 0, remaining);
-                }
-            }
-                pageTable[vpn].virtualPage  = vpn;
-                pageTable[vpn].physicalPage = ppn;
-                pageTable[vpn].valid = true;
-                DEBUG('k',"Page loaded succesfully. VPN: %d, PPN: %d\n",vpn,ppn);
+        // Data segment
+        if((virtualAddr < dataSize+dataAddr) && (remaining>0) && (dataSize)){
+          DEBUG('k',"Data Page\n");
+          sizeToRead = min(remaining, (dataSize + dataAddr) - virtualAddr);
+          offset = max(0,virtualAddr - dataAddr);
+          exe->ReadDataBlock(&mainMemory[realAddr + (PAGE_SIZE - remaining)],sizeToRead,offset);
+          remaining -= sizeToRead;
+          virtualAddr += sizeToRead;
+        }
+
+        // Stack segment
+        if(remaining>0){
+          DEBUG('k',"Stack Page\n");
+          memset(mainMemory + ((ppn+1) * PAGE_SIZE - remaining), 0, remaining);
         }
     }
-    return pageTable[vpn];
+    pageTable[vpn].virtualPage  = vpn;
+    pageTable[vpn].physicalPage = ppn;
+    pageTable[vpn].use = false;
+    pageTable[vpn].dirty = false;
+    pageTable[vpn].valid = true;
+    // The page may have been shared after a `Fork` the last time it was in
+    // memory.
+    pageTable[vpn].readOnly = IsCodePage(vpn);
+}
+
+/* Mapea la pagina `vpn` al marco de ceros, si nunca se escribio, no es de un
+   archivo mapeado ni esta en el ejecutable.  Queda de solo lectura: la primera
+   escritura pasa por `CopyOnWrite`, que le da un marco propio. */
+bool
+AddressSpace::MapZeroPage(unsigned vpn){
+    if(mapping[vpn] != nullptr || pageState[vpn] != PAGE_ZERO_FILL)
+        return false;
+
+    DEBUG('k',"Mapping page %u to the frame of zeroes.\n", vpn);
+    stats->numZeroPagesMapped++;
+    pageTable[vpn].virtualPage  = vpn;
+    pageTable[vpn].physicalPage = coreMap->GetZeroFrame();
+    pageTable[vpn].use = false;
+    pageTable[vpn].dirty = false;
+    pageTable[vpn].valid = true;
+    pageTable[vpn].readOnly = true;
+    return true;
 }
 
-/* Dada una pagina fisica, busca si existe la pagina virtual. */
+/* Una pagina se comparte si tiene solo codigo: la primera y la ultima pagina
+   del segmento de codigo pueden tener tambien datos. */
+bool
+AddressSpace::IsCodePage(unsigned vpn) const{
+    unsigned codeAddr = exe->GetCodeAddr();
+    unsigned codeSize = exe->GetCodeSize();
+    return vpn * PAGE_SIZE >= codeAddr && (vpn + 1) * PAGE_SIZE <= codeAddr + codeSize;
+}
+
+/* Si otro proceso con el mismo ejecutable ya tiene en memoria la pagina de
+   codigo `vpn`, la mapea en este espacio y devuelve el marco, fijado.  Si no,
+   devuelve -1. */
 int
-AddressSpace::FindVirtualPage(unsigned ppn){
-    int vpn = -1;
-    // Look for the virtual page that matches this physical page.
-    for(unsigned i = 0; i < numPages; i++ ){
-        // DEBUG('k',"i: %d, PP: %d, VALID: %d PPN: %d\n",i,pageTable[i].physicalPage, pageTable[i].valid, ppn);
-        if(pageTable[i].physicalPage == ppn && pageTable[i].valid ){
-        vpn = i;
-        break;
+AddressSpace::MapSharedPage(unsigned vpn){
+    if(!IsCodePage(vpn))
+        return -1;
+    int ppn = coreMap->FindShared(exeFile, vpn, this);
+    if(ppn < 0)
+        return -1;
+    DEBUG('k',"Sharing code page %u in frame %d.\n", vpn, ppn);
+    stats->numPagesShared++;
+    pageTable[vpn].physicalPage = ppn;
+    pageTable[vpn].use = false;
+    pageTable[vpn].dirty = false;
+    pageTable[vpn].valid = true;
+    return ppn;
+}
+
+/* Deja de mapear la pagina `vpn`, que es compartida y se desaloja.  Si fue
+   modificada, `CoreMap::Evict` la guarda despues con `FinishUnmap`; si no, se
+   vuelve a leer del ejecutable. */
+void
+AddressSpace::UnmapPage(unsigned vpn){
+    ASSERT(vpn < numPages && pageTable.IsValid(vpn));
+
+    BeginEviction(vpn);
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for(unsigned i = 0; i < machine->GetMMU()->GetTLBSize(); ++i)
+        if(tlb[i].valid && tlb[i].asid == (unsigned) asid && tlb[i].virtualPage == vpn)
+            tlb[i].valid = false;
+    pageTable[vpn].valid = false;
+    pageTable[vpn].physicalPage = numPages + 1;
+    tablesToReclaim = true;
+}
+
+/* Termina el desalojo de la pagina compartida `vpn`, que esta en el marco `ppn`
+   y ya no esta mapeada: si `save`, o si este proceso no tiene una copia al dia,
+   la guarda en su swap. */
+void
+AddressSpace::FinishUnmap(unsigned vpn, unsigned ppn, bool save){
+    ASSERT(vpn < numPages && !pageTable.IsValid(vpn));
+    if(save || pageState[vpn] == PAGE_SWAP_STALE){
+        char *mainMemory = machine->GetMMU()->mainMemory;
+        DEBUG('s',"Saving shared page %u of address space %d.\n", vpn, asid);
+        // `CoreMap::Evict` took the slot with `ReserveSwapSlot`.
+        swapArea->WritePage(swapSlot[vpn], &mainMemory[ppn * PAGE_SIZE]);
+        pageState[vpn] = PAGE_IN_SWAP;
+        stats->numSwapWrites++;
+        stats->numPagesSwappedOut++;
+    } else
+        stats->numCleanEvictions++;
+    EndEviction(vpn);
+}
+
+/* Resuelve una escritura en la pagina `vpn`, compartida con otro proceso desde
+   un `Fork`.  Si ningun otro proceso la mapea ya, el marco pasa a ser de este;
+   si no, se copia en un marco nuevo, desalojando otra pagina si hace falta.
+   Devuelve false si la pagina es de solo lectura de verdad, es decir, si es de
+   codigo.
+
+   Si la pagina mapea el marco de ceros, recien ahora se le da un marco, que
+   `FillFrame` llena de ceros.  Si no hay marco para la copia porque el swap
+   esta lleno, tambien devuelve false. */
+bool
+AddressSpace::CopyOnWrite(unsigned vpn){
+    if(vpn >= numPages || !pageTable.IsValid(vpn) || !pageTable[vpn].readOnly || IsCodePage(vpn))
+        return false;
+
+    SaveState();
+    unsigned old = pageTable[vpn].physicalPage;
+    unsigned ppn = old;
+    if(coreMap->IsZeroFrame(old)){
+        int frame = coreMap->FindOrEvict(this, &pageTable[vpn]);
+        if(frame < 0){
+            DEBUG('k',"Out of swap writing page %u.\n", vpn);
+            return false;
+        }
+        ppn = frame;
+        DEBUG('k',"Giving zero-fill page %u frame %u.\n", vpn, ppn);
+        FillFrame(vpn, ppn);
+        stats->numZeroPagesFilled++;
+    } else if(coreMap->CountSharers(old) == 1){
+        ASSERT(coreMap->IsShared(old));
+        coreMap->Pin(old);
+        DEBUG('k',"Taking shared page %u in frame %u.\n", vpn, old);
+        coreMap->MakePrivate(old, this, &pageTable[vpn]);
+        stats->numPagesReclaimed++;
+    } else {
+        ASSERT(coreMap->IsShared(old));
+        coreMap->Pin(old);
+        int frame = coreMap->FindOrEvict(this, &pageTable[vpn]);
+        if(frame < 0){
+            DEBUG('k',"Out of swap writing page %u.\n", vpn);
+            coreMap->Unpin(old);
+            return false;
         }
+        ppn = frame;
+        DEBUG('k',"Copying shared page %u from frame %u to %u.\n", vpn, old, ppn);
+        char *mainMemory = machine->GetMMU()->mainMemory;
+        memcpy(&mainMemory[ppn * PAGE_SIZE], &mainMemory[old * PAGE_SIZE], PAGE_SIZE);
+        stats->numPagesCopied++;
+        coreMap->Unpin(old);
+        coreMap->Unshare(old, this);
+        pageTable[vpn].physicalPage = ppn;
     }
-    return vpn;
+
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for(unsigned i = 0; i < machine->GetMMU()->GetTLBSize(); ++i)
+        if(tlb[i].valid && tlb[i].asid == (unsigned) asid && tlb[i].virtualPage == vpn)
+            tlb[i].valid = false;
+    pageTable[vpn].readOnly = false;
+    pageTable[vpn].use = true;
+    pageTable[vpn].dirty = true;
+    coreMap->Unpin(ppn);
+    return true;
 }
 
-/* Luego de que el `ClearPage` seleccione una pagina victima, se remueve utilizando este metodo, que dependiendo de si la pagina 
-se encontraba sucia, se guarda en swap. Luego se invalidan las paginas de la tlb y se actualiza el estado.  */
+/* Carga las paginas del grupo alineado de `FAULT_AROUND_PAGES` que contiene a
+   `vpn` y que todavia no estan en memoria, mientras haya marcos libres por
+   encima de la reserva del daemon de pageout: nunca se desaloja una pagina para
+   adelantar otra.  Las paginas cargadas no se ponen en la TLB; si se usan, el
+   fallo de TLB las encuentra validas en la tabla de paginas. */
 void
-AddressSpace::RemovePage(unsigned ppn){
+AddressSpace::FaultAround(unsigned vpn){
+    unsigned first = vpn - vpn % FAULT_AROUND_PAGES;
+    for (unsigned page = first; page < first + FAULT_AROUND_PAGES && page < numPages; page++) {
+        if (pageTable.IsValid(page) || evicting[page] || !IsAddressable(page))
+            continue;
+        if (MapZeroPage(page))
+            continue;
+        int ppn = MapSharedPage(page);
+        if (ppn < 0) {
+            if (coreMap->IsMemoryLow())
+                break;
+            ppn = coreMap->Find(this, &pageTable[page]);
+            if (ppn < 0)
+                break;
+            DEBUG('k',"Loading page %u around page %u.\n", page, vpn);
+            stats->numPagesPrefetched++;
+            FillFrame(page, ppn);
+            if (IsCodePage(page))
+                coreMap->MakeShared(ppn, exeFile, page);
+        }
+        coreMap->Unpin(ppn);
+    }
+}
+
+/* Se remueve la pagina elegida como victima.  Primero se invalida, junto con su
+   entrada de la tlb, copiando el estado de esta a la tabla de paginas, para que
+   nadie la modifique mientras se guarda; luego, si hay que guardarla, se guarda
+   en su archivo si esta mapeada, o si no en swap junto con las paginas vecinas
+   modificadas, y se libera el marco.  Una pagina que no cambio desde que se
+   leyo, del swap o del ejecutable, se descarta sin escribir nada.
+
+   Con el swap lleno, una pagina que hay que guardar y que todavia no tiene slot
+   se deja como esta. */
+bool
+AddressSpace::RemovePage(unsigned vpn){
+    ASSERT(vpn < numPages && pageTable.IsValid(vpn));
+
+    unsigned ppn = pageTable[vpn].physicalPage;
     unsigned frame = ppn * PAGE_SIZE;
     char *mainMemory = machine->GetMMU()->mainMemory;
-    
-    int vpn = FindVirtualPage(ppn);
-    if(vpn < 0){
-        DEBUG('k',"Physical page (%d) doesn't match with any Virtual page.\n", ppn);
-        currentThread->Finish();
-    } else{
-        
-        if(pageTable[vpn].dirty){
-            // Save it at SWAP.
-            DEBUG('s',"Saving page at SWAP.%d file.\n",currentThread->space->asid);
-            //pageState[vpn] = 1;
-            swapFile->WriteAt(&mainMemory[frame], PAGE_SIZE, vpn * PAGE_SIZE);
-            memset(&mainMemory[frame], 0, PAGE_SIZE);
+
+    if(!ReserveSwapSlot(vpn, coreMap->IsDirty(ppn))){
+        DEBUG('s',"Out of swap for page %u of address space %d.\n", vpn, asid);
+        return false;
+    }
+
+    // Marked before invalidating the page, so that its owner, if it faults
+    // on it, waits until it is saved.
+    BeginEviction(vpn);
+
+    // A frame has only one owner, so an entry of the TLB that maps it
+    // belongs to this address space.
+    TranslationEntry *tlb = machine -> GetMMU() -> tlb;
+    for(unsigned i = 0; i < machine->GetMMU()->GetTLBSize(); ++i)
+        if(tlb[i].valid && tlb[i].physicalPage == ppn){
+            pageTable[vpn].dirty = tlb[i].dirty;
+            pageTable[vpn].use = tlb[i].use;
+            tlb[i].valid = false;
+            break;
         }
+    pageTable[vpn].valid = false;
+    pageTable[vpn].physicalPage = numPages + 1;
+    tablesToReclaim = true;
+    paging.evictions++;
 
-        TranslationEntry *tlb = machine -> GetMMU() -> tlb;
-        // Invalidamos las paginas de la tlb y ademas le copiamos el estado.
-        pageTable[vpn].valid = false;
-        pageTable[vpn].physicalPage = numPages + 1;
-        for(unsigned i = 0; i < TLB_SIZE; ++i)
-            if(tlb[i].physicalPage == ppn && tlb[i].valid){
-
-                // Update the tablePage entry with actual tlb entry.
-                pageTable[vpn].virtualPage = tlb[i].virtualPage;
-                pageTable[vpn].dirty = tlb[i].dirty;
-                pageTable[vpn].readOnly = tlb[i].readOnly;
-                pageTable[vpn].use = tlb[i].use;
-
-                tlb[i].valid = false;
-                tlb[i].physicalPage = numPages+1;
-                break;
-            }   
-        if(currentThread->space == this)            
-		    SaveState();
-        freeMemMap->Clear(ppn);
+    if(MustSave(vpn)){
+        if(mapping[vpn] != nullptr)
+            WriteMappedPage(vpn, &mainMemory[frame]);
+        else
+            WriteCluster(vpn, ppn);
+    } else
+        stats->numCleanEvictions++;
+    coreMap->Release(ppn);
+    EndEviction(vpn);
+    return true;
+}
+
+/* Las paginas de archivos mapeados se guardan en su archivo, y las que no
+   cambiaron no se guardan. */
+bool
+AddressSpace::ReserveSwapSlot(unsigned vpn, bool dirty){
+    if(mapping[vpn] != nullptr || (!dirty && pageState[vpn] != PAGE_SWAP_STALE))
+        return true;
+    return GetSwapSlot(vpn) >= 0;
+}
+
+/* Una pagina hay que guardarla si fue modificada desde que se cargo, o si ya lo
+   estaba antes y todavia no se guardo. */
+bool
+AddressSpace::MustSave(unsigned vpn) const{
+    return pageTable.Find(vpn)->dirty || pageState[vpn] == PAGE_SWAP_STALE;
+}
+
+/* Una pagina vecina se guarda junto con la victima si esta en memoria, es solo
+   de este proceso, no es de un archivo mapeado, hay que guardarla y nadie tiene
+   fijado su marco. */
+bool
+AddressSpace::IsClusterable(unsigned vpn) const{
+    if (!pageTable.IsValid(vpn) || mapping[vpn] != nullptr)
+        return false;
+    unsigned ppn = pageTable.Find(vpn)->physicalPage;
+    return !coreMap->IsShared(ppn)
+           && (coreMap->IsDirty(ppn) || pageState[vpn] == PAGE_SWAP_STALE)
+           && !coreMap->IsPinned(ppn);
+}
+
+/* Guarda en swap la pagina `vpn`, que estaba en el marco `ppn`, junto con
+   las paginas modificadas contiguas a ella dentro de su grupo alineado de
+   `SWAP_CLUSTER_PAGES`, en una sola transferencia a slots consecutivos.
+   Las vecinas siguen en memoria, pero quedan sin modificar porque su copia
+   en swap esta al dia; sus bits se limpian antes de copiarlas, asi que si
+   el proceso las vuelve a escribir durante la escritura quedan sucias otra
+   vez.  Sus marcos quedan fijados hasta que termina la escritura, para que
+   nadie las desaloje y las lea del swap antes.
+
+   Si no hay slots consecutivos libres para todas, la victima se guarda
+   sola, en su slot y a traves del cache, y las vecinas esperan a su turno.
+*/
+void
+AddressSpace::WriteCluster(unsigned vpn, unsigned ppn){
+    unsigned groupFirst = vpn - vpn % SWAP_CLUSTER_PAGES;
+    unsigned groupLast  = min(groupFirst + SWAP_CLUSTER_PAGES, numPages) - 1;
+    unsigned first = vpn, last = vpn;
+    while (first > groupFirst && IsClusterable(first - 1))
+        first--;
+    while (last < groupLast && IsClusterable(last + 1))
+        last++;
+    unsigned count = last - first + 1;
+    if (count > 1 && GetSwapRun(first, count) < 0) {
+        first = last = vpn;
+        count = 1;
+    }
+
+    // Out of the stack of the thread, which may be too small for big pages.
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    char *buffer = new char [count * PAGE_SIZE];
+    for (unsigned page = first; page <= last; page++) {
+        unsigned frame = page == vpn ? ppn : pageTable[page].physicalPage;
+        if (page != vpn) {
+            coreMap->Pin(frame);
+            coreMap->ClearDirty(frame);
+        }
+        pageState[page] = PAGE_IN_SWAP;
+        memcpy(&buffer[(page - first) * PAGE_SIZE],
+               &mainMemory[frame * PAGE_SIZE], PAGE_SIZE);
+    }
+
+    DEBUG('s',"Saving pages %u to %u of address space %d.\n", first, last, asid);
+    if (count == 1)
+        swapArea->WritePage(swapSlot[vpn], buffer);
+    else
+        swapArea->WriteRun(swapSlot[first], buffer, count);
+    stats->numSwapWrites++;
+    stats->numPagesSwappedOut += count;
+    paging.swapOuts += count;
+    delete [] buffer;
+
+    for (unsigned page = first; page <= last; page++)
+        if (page != vpn)
+            coreMap->Unpin(pageTable[page].physicalPage);
+}
+
+/* Si las paginas ya tienen slots consecutivos, se reusan; si no, se toma
+   una tanda nueva, lo mas cerca posible del slot de la primera, y los
+   slots viejos se liberan.  Devuelve el primer slot, o -1 si no hay una
+   tanda libre del largo pedido. */
+int
+AddressSpace::GetSwapRun(unsigned first, unsigned count){
+    bool contiguous = swapSlot[first] >= 0;
+    for (unsigned i = 1; i < count && contiguous; i++)
+        contiguous = swapSlot[first + i] == swapSlot[first] + (int) i;
+    if (contiguous)
+        return swapSlot[first];
+
+    unsigned hint = swapSlot[first] >= 0 ? swapSlot[first] : 0;
+    int run = swapArea->AllocateRun(count, hint);
+    if (run < 0)
+        return -1;
+    for (unsigned i = 0; i < count; i++) {
+        if (swapSlot[first + i] >= 0)
+            swapArea->Free(swapSlot[first + i]);
+        swapSlot[first + i] = run + i;
+    }
+    return run;
+}
+
+/* Lee la pagina mapeada `vpn` de su archivo.  Lo que queda despues del final de
+   la asignacion, o del archivo, se completa con ceros. */
+void
+AddressSpace::ReadMappedPage(unsigned vpn, char *data){
+    MappedFile *m = mapping[vpn];
+    unsigned start = (vpn - m->firstPage) * PAGE_SIZE;
+    memset(data, 0, PAGE_SIZE);
+    m->file->ReadAt(data, min(PAGE_SIZE, m->length - start), m->offset + start);
+    stats->numMappedReads++;
+}
+
+/* Guarda la pagina mapeada `vpn` en su archivo: solo los bytes que caen dentro
+   de la asignacion, que pueden hacer crecer el archivo. */
+void
+AddressSpace::WriteMappedPage(unsigned vpn, const char *data){
+    MappedFile *m = mapping[vpn];
+    unsigned start = (vpn - m->firstPage) * PAGE_SIZE;
+    DEBUG('s',"Writing page %u of address space %d back to its file.\n", vpn, asid);
+    m->file->WriteAt(data, min(PAGE_SIZE, m->length - start), m->offset + start);
+    stats->numMappedWrites++;
+}
+
+/* Busca en el area de archivos mapeados la primera tanda de paginas libres
+   consecutivas en la que entren `length` bytes.  Las paginas quedan invalidas:
+   se leen del archivo recien cuando el programa las usa. */
+int
+AddressSpace::Map(OpenFile *file, unsigned offset, unsigned length){
+    ASSERT(file != nullptr);
+    ASSERT(length > 0);
+
+    unsigned pages = DivRoundUp(length, PAGE_SIZE);
+    unsigned first = mmapFirstPage, found = 0;
+    for (unsigned vpn = mmapFirstPage; vpn < heapFirstPage && found < pages; vpn++)
+        if (mapping[vpn] != nullptr) {
+            first = vpn + 1;
+            found = 0;
+        } else
+            found++;
+    if (found < pages)
+        return -1;
+
+    // Opening the file again may let other threads run, so the pages are
+    // taken afterwards.
+    MappedFile *m = new MappedFile {file->Reopen(), offset, length, first, pages};
+    for (unsigned vpn = first; vpn < first + pages; vpn++) {
+        ASSERT(!pageTable.IsValid(vpn) && !evicting[vpn]);
+        mapping[vpn] = m;
+    }
+    DEBUG('k',"Mapped %u bytes at %u of a file in pages %u to %u.\n",
+          length, offset, first, first + pages - 1);
+    return first * PAGE_SIZE;
+}
+
+/* Quita la asignacion que empieza en la direccion `address`.  Sus paginas en
+   memoria se desalojan como si fueran victimas, asi que las modificadas se
+   guardan en el archivo.  Antes de mirar cada una se espera a que termine su
+   desalojo, si otro hilo la esta guardando, y su marco se fija para que el
+   daemon de pageout no la elija mientras se escribe. */
+bool
+AddressSpace::Unmap(unsigned address){
+    unsigned first = address / PAGE_SIZE;
+    if (address % PAGE_SIZE != 0 || first < mmapFirstPage || first >= heapFirstPage
+          || mapping[first] == nullptr || mapping[first]->firstPage != first)
+        return false;
+
+    MappedFile *m = mapping[first];
+    DEBUG('k',"Unmapping pages %u to %u.\n", first, first + m->numPages - 1);
+    for (unsigned vpn = first; vpn < first + m->numPages; vpn++) {
+        WaitForPage(vpn);
+        if (pageTable.IsValid(vpn)) {
+            coreMap->Pin(pageTable[vpn].physicalPage);
+            RemovePage(vpn);
+        }
+        mapping[vpn] = nullptr;
+    }
+    delete m->file;
+    delete m;
+    return true;
+}
+
+bool
+AddressSpace::IsAddressable(unsigned vpn) const{
+    return vpn < mmapFirstPage || (vpn >= heapFirstPage && vpn < numPages)
+           || (vpn < numPages && mapping[vpn] != nullptr);
+}
+
+/* Devuelve el slot del area de swap de la pagina `vpn`, que se reserva la
+   primera vez que se guarda y se conserva mientras viva el proceso. */
+int
+AddressSpace::GetSwapSlot(unsigned vpn){
+    if(swapSlot[vpn] < 0)
+        swapSlot[vpn] = swapArea->Allocate();
+    return swapSlot[vpn];
+}
+
+/* Libera los slots del area de swap del proceso. */
+void
+AddressSpace::ReleaseSwap(){
+    for (unsigned i = 0; i < numPages; i++)
+        if (swapSlot[i] >= 0) {
+            swapArea->Free(swapSlot[i]);
+            swapSlot[i] = -1;
+        }
+}
+
+/* Una pagina esta en el working set si se uso en los ultimos
+   `WORKING_SET_WINDOW` ticks, aunque ya no este en memoria.  Los bits de uso de
+   las paginas privadas se limpian, para ver si se vuelven a usar antes de la
+   proxima muestra; los de las compartidas no, porque son de todos los procesos
+   que las mapean. */
+unsigned
+AddressSpace::SampleWorkingSet(){
+    unsigned long now = stats->totalTicks;
+    workingSet = 0;
+    for (unsigned i = 0; i < numPages; i++) {
+        if (pageTable.IsValid(i)) {
+            unsigned ppn = pageTable[i].physicalPage;
+            if (coreMap->IsReferenced(ppn)) {
+                lastUse[i] = now;
+                if (!coreMap->IsShared(ppn))
+                    coreMap->ClearReferenced(ppn);
+            }
+        }
+        if (lastUse[i] > 0 && now - lastUse[i] < WORKING_SET_WINDOW)
+            workingSet++;
     }
-  }   
+    return workingSet;
+}
+
+unsigned
+AddressSpace::GetWorkingSet() const{
+    return workingSet;
+}
 
-TranslationEntry * 
+/* Desaloja las paginas del proceso para suspenderlo.  Quedan las compartidas,
+   que otros procesos pueden estar usando, y las de marcos fijados, que alguien
+   esta cargando o guardando, y las que habria que guardar con el swap lleno.
+   Cada desalojo puede ceder el procesador, asi que cada pagina se mira recien
+   al llegar a ella. */
+void
+AddressSpace::SwapOut(){
+    for (unsigned i = 0; i < numPages; i++) {
+        if (!pageTable.IsValid(i) || evicting[i])
+            continue;
+        unsigned ppn = pageTable[i].physicalPage;
+        if (coreMap->IsZeroFrame(ppn) || coreMap->IsShared(ppn) || coreMap->IsPinned(ppn))
+            continue;
+        coreMap->Pin(ppn);
+        if (!RemovePage(i))
+            coreMap->Unpin(ppn);
+    }
+}
+
+/* Marca que la pagina `vpn` se empieza a guardar en swap, posiblemente desde
+   otro hilo.  No toma el lock: tomarlo puede ceder el procesador, y quien
+   desaloja no debe hacerlo hasta terminar de invalidar la pagina.  Nadie espera
+   sin antes mirar estos campos, asi que no se pierde ningun aviso. */
+void
+AddressSpace::BeginEviction(unsigned vpn){
+    ASSERT(!evicting[vpn]);
+    evicting[vpn] = true;
+    pendingEvictions++;
+}
+
+/* Marca que la pagina `vpn` ya se termino de guardar, despertando a quien la espere. */
+void
+AddressSpace::EndEviction(unsigned vpn){
+    evictionLock->Acquire();
+    ASSERT(evicting[vpn] && pendingEvictions > 0);
+    evicting[vpn] = false;
+    pendingEvictions--;
+    evictionDone->Broadcast();
+    evictionLock->Release();
+}
+
+/* Espera a que se termine de guardar la pagina `vpn`, si se esta guardando.
+   Soltar el lock puede ceder el procesador, y mientras tanto otro hilo puede
+   empezar a desalojarla de nuevo, asi que se vuelve a mirar: al volver, la
+   pagina no se esta guardando, y sigue asi hasta que quien llama ceda el
+   procesador. */
+void
+AddressSpace::WaitForPage(unsigned vpn){
+    while (evicting[vpn]) {
+        evictionLock->Acquire();
+        while (evicting[vpn])
+            evictionDone->Wait();
+        evictionLock->Release();
+    }
+}
+
+/* Espera a que se terminen de guardar todas las paginas del proceso que se
+   estan guardando, como `WaitForPage`. */
+void
+AddressSpace::WaitForEvictions(){
+    while (pendingEvictions > 0) {
+        evictionLock->Acquire();
+        while (pendingEvictions > 0)
+            evictionDone->Wait();
+        evictionLock->Release();
+    }
+}
+
+/* Libera los marcos del proceso, invalidando las entradas de la tlb que los
+   referencian.  Los marcos compartidos se liberan solo si ningun otro proceso
+   los usa.  Primero se quitan los archivos mapeados, guardando sus paginas
+   modificadas.
+
+   Antes se espera a que terminen los desalojos de paginas de este proceso que
+   otros hilos, como el daemon de pageout, tengan a medio escribir: al terminar
+   tocan la tabla de paginas y desfijan los marcos vecinos. */
+void
+AddressSpace::ReleaseFrames(){
+    for (unsigned i = mmapFirstPage; i < heapFirstPage; i++)
+        if (mapping[i] != nullptr && mapping[i]->firstPage == i)
+            Unmap(i * PAGE_SIZE);
+    WaitForEvictions();
+
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for (unsigned i = 0; i < numPages; i++)
+        if (pageTable.IsValid(i)) {
+            unsigned ppn = pageTable[i].physicalPage;
+            for (unsigned j = 0; j < machine->GetMMU()->GetTLBSize(); j++)
+                if (tlb[j].valid && tlb[j].asid == (unsigned) asid && tlb[j].physicalPage == ppn)
+                    tlb[j].valid = false;
+            if (coreMap->IsShared(ppn))
+                coreMap->Unshare(ppn, this);
+            else if (!coreMap->IsZeroFrame(ppn))
+                coreMap->Release(ppn);
+            pageTable[i].valid = false;
+        }
+}
+
+PageTable *
 AddressSpace::GetPageTable(){
-    return pageTable;
+    return &pageTable;
 }
 
-#endif
+/* Una tabla con una pagina que se esta desalojando no se libera todavia: quien
+   la desaloja vuelve a tocar su entrada.  Queda pendiente para la proxima vez.
+*/
+void
+AddressSpace::ReclaimTables(){
+    if (!tablesToReclaim)
+        return;
+    tablesToReclaim = false;
+    for (unsigned table = 0; table < pageTable.GetNumTables(); table++) {
+        unsigned first = table * PAGE_TABLE_ENTRIES;
+        unsigned last  = min(first + PAGE_TABLE_ENTRIES, numPages);
+        bool busy = false;
+        for (unsigned vpn = first; vpn < last && !busy; vpn++)
+            busy = evicting[vpn];
+        if (busy)
+            tablesToReclaim = true;
+        else if (pageTable.Reclaim(table))
+            DEBUG('a', "Freed page table of pages %u to %u of address space %d.\n",
+                  first, last - 1, asid);
+    }
+}
 
+#endif
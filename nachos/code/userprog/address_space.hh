@@ -16,10 +16,65 @@
 
 #include "filesys/file_system.hh"
 #include "machine/translation_entry.hh"
+#include "userprog/syscall.h"
 #include "executable.hh"
+#ifdef USE_TLB
+#include "page_table.hh"
+#endif
+
+
+class Lock;
+class Condition;
 
 const unsigned USER_STACK_SIZE = 1024;  ///< Increase this as necessary!
 
+/// On a page fault, the other pages of the aligned group of this many pages
+/// are loaded too, as long as there are free frames.
+const unsigned FAULT_AROUND_PAGES = 4;
+
+/// Maximum number of pages written to swap together when a modified page is
+/// evicted.
+const unsigned SWAP_CLUSTER_PAGES = 8;
+
+/// Number of virtual pages, right after the stack, where files can be
+/// mapped with `Mmap`.
+const unsigned MMAP_PAGES = 64;
+
+/// Maximum number of bytes the heap can grow with `Sbrk`.
+const unsigned USER_HEAP_MAX_SIZE = 64 * 1024;
+
+
+#ifdef USE_TLB
+/// Where the latest contents of a page that is not mapped from a file can
+/// be found, besides its frame if it is in memory.
+enum PageState {
+    PAGE_IN_EXECUTABLE,  ///< Never saved; loaded from the executable.
+    PAGE_ZERO_FILL,      ///< Never saved, and outside the segments of the
+                         ///< executable: loaded as zeroes.
+    PAGE_IN_SWAP,        ///< Saved in its swap slot, which is up to date
+                         ///< unless the page is dirty in its frame.
+    PAGE_SWAP_STALE      ///< In memory, and its frame is newer than any
+                         ///< copy of it, so it must be saved if evicted.
+};
+
+/// A part of a file mapped into an address space by `Mmap`.
+struct MappedFile {
+
+    /// The file, opened again for the mapping, so that it outlives the
+    /// descriptor of the program.
+    OpenFile *file;
+
+    /// Position in the file of the first byte mapped, and number of bytes
+    /// mapped.
+    unsigned offset;
+    unsigned length;
+
+    /// First virtual page of the mapping, and number of pages.
+    unsigned firstPage;
+    unsigned numPages;
+};
+#endif
+
 
 class AddressSpace {
 public:
@@ -36,6 +91,19 @@ public:
     ///   program; it contains the object code to load into memory.
     AddressSpace(OpenFile *executable_file, int id);
 
+    #ifdef USE_TLB
+    /// Create a copy of the address space `parent`, for a child created by
+    /// `Fork`.  The pages in memory are shared with the parent and made
+    /// read-only, and each process gets its own copy of a page the first
+    /// time it writes it (see `CopyOnWrite`).  Check `IsComplete`
+    /// afterwards.
+    AddressSpace(AddressSpace *parent, int id);
+
+    /// Whether the copy of the parent got every page: the ones it has in
+    /// swap need slots of their own, and swap may be full.
+    bool IsComplete() const;
+    #endif
+
     /// De-allocate an address space.
     ~AddressSpace();
 
@@ -47,30 +115,222 @@ public:
     void SaveState();
     void RestoreState();
 
+    /// Move the end of the heap `increment` bytes up, adding pages to the
+    /// address space if needed, and return its previous address; return -1
+    /// if the heap can not grow that much.  New pages start zeroed.
+    int Sbrk(unsigned increment);
+
+    /// Paging events of this address space, counted where they happen.
+    PagingStats *GetPagingStats();
+
+    /// Print the paging events; called when the program exits.
+    void PrintPagingStats() const;
+
+    /// Bring page `vpn` into memory, with a frame of its own if it is going
+    /// to be written, and pin its frame so that the kernel can transfer
+    /// data to or from it directly, even if it lets other threads run.
+    /// Return the frame, or -1 if the page is not in the address space or
+    /// can not be written.
+    int PinPage(unsigned vpn, bool write);
+
+    /// Release a frame pinned by `PinPage`.
+    void UnpinPage(unsigned ppn);
+
     #ifdef USE_TLB
-    TranslationEntry *GetPageTable();
+    PageTable *GetPageTable();
+
+    /// Bring the virtual page `vpn` into a physical frame, evicting some
+    /// other page if memory is full.  Return false if no page could be
+    /// evicted because swap is full.
+    bool LoadPage(unsigned vpn);
+
+    /// Whether page `vpn` can be evicted: if it was modified, it needs a
+    /// swap slot, which is taken now.
+    bool ReserveSwapSlot(unsigned vpn, bool dirty);
+
+    /// Evict the virtual page `vpn`, saving it in swap if it was modified,
+    /// and free its frame.  Modified pages next to it are saved along with
+    /// it, but stay in memory.  Return false, leaving the page in memory,
+    /// if it has to be saved and swap is full.
+    bool RemovePage(unsigned vpn);
+
+    /// Stop mapping the shared page `vpn`, because it is being evicted.
+    /// The eviction is not over until `FinishUnmap` is called.
+    void UnmapPage(unsigned vpn);
+
+    /// Finish the eviction of the shared page `vpn`, held in frame `ppn`
+    /// and unmapped by `UnmapPage`, saving it in swap first if `save`.
+    void FinishUnmap(unsigned vpn, unsigned ppn, bool save);
+
+    /// Handle a write to the page `vpn`, made read-only because it is
+    /// shared with a parent or child, or because it maps the frame of
+    /// zeroes: give this address space a private copy that it can modify.
+    /// Return false if the page must really not be written, or if there is
+    /// no frame for the copy because swap is full.
+    bool CopyOnWrite(unsigned vpn);
+
+    /// Map `length` bytes of `file`, from position `offset`, into free
+    /// pages of the area after the stack, and return the virtual address
+    /// of the first one, or -1 if there is no room.  The pages are loaded
+    /// from the file when used, and written back to it when evicted or
+    /// unmapped if they were modified.
+    int Map(OpenFile *file, unsigned offset, unsigned length);
 
-    TranslationEntry LoadPage(unsigned vpn);
+    /// Remove the mapping that starts at virtual address `address`,
+    /// writing its modified pages back to the file.  Return false if no
+    /// mapping starts there.
+    bool Unmap(unsigned address);
 
-    int FindVirtualPage(unsigned ppn);
+    /// Whether the program may use page `vpn`: it is below the area of
+    /// mapped files, part of a mapping, or part of the heap.
+    bool IsAddressable(unsigned vpn) const;
 
-    void RemovePage(unsigned idx);
+    /// Remove every mapping and free every frame used by this address
+    /// space, once no other thread is evicting its pages.  Called when the
+    /// program exits.
+    void ReleaseFrames();
 
-    unsigned NextVictim();
+    /// Free every swap slot used by this address space.  Called when the
+    /// program exits.
+    void ReleaseSwap();
+
+    /// Estimate the working set: count the pages referenced in the last
+    /// `WORKING_SET_WINDOW` ticks, in memory or not, and return it.
+    unsigned SampleWorkingSet();
+
+    /// The working set counted by the last `SampleWorkingSet`.
+    unsigned GetWorkingSet() const;
+
+    /// Evict every page that is only used by this address space, to
+    /// suspend its program.
+    void SwapOut();
 
     #endif
 
-    OpenFile *swapFile;
 private:
 
     Executable *exe;
 
+    PagingStats paging;
+
     int asid;
 
-    char* pageState;
+    /// First page of the heap, the last area of the address space, and
+    /// address of its end.  The pages after `heapFirstPage` are added as
+    /// the end moves up.
+    unsigned heapFirstPage;
+    unsigned heapBreak;
+
+    /// Make room for `pages` pages in the page table, and replace the
+    /// other per page arrays by larger ones, the new pages empty.
+    void Grow(unsigned pages);
+
+    #ifdef USE_TLB
+    /// Backing store of each page.  Evicting a page that is not dirty and
+    /// not `PAGE_SWAP_STALE` costs no writes.
+    PageState *pageState;
+
+    /// Whether page `vpn` must be saved if it is evicted now.
+    bool MustSave(unsigned vpn) const;
+
+    /// Time at which each page was last found referenced, or 0 if never.
+    unsigned long *lastUse;
+
+    /// Pages in the working set at the last sample.
+    unsigned workingSet;
+
+    /// Identifier of the executable, to share its code pages with other
+    /// address spaces running it.
+    int exeFile;
+
+    /// Number of pages of this address space that other threads are
+    /// evicting, and will touch its page table when they are done.
+    unsigned pendingEvictions;
+
+    /// Whether each page is being saved by one of those evictions; it must
+    /// not be loaded again until it is done.
+    bool *evicting;
+
+    /// Used to wait for the evictions above; `evictionDone` is signalled
+    /// whenever one of them ends.
+    Lock *evictionLock;
+    Condition *evictionDone;
+
+    /// Mark the eviction of page `vpn` as started or finished.
+    void BeginEviction(unsigned vpn);
+    void EndEviction(unsigned vpn);
+
+    /// Wait until page `vpn`, or every page, is not being evicted, without
+    /// yielding the CPU after checking it.
+    void WaitForPage(unsigned vpn);
+    void WaitForEvictions();
+
+    /// Slot of the swap area that holds each page, or -1 if the page was
+    /// never saved.  A page keeps its slot while the process lives, even
+    /// when the copy in it becomes stale.
+    int *swapSlot;
 
+    /// Return the swap slot of page `vpn`, allocating one if it has none,
+    /// or -1 if swap is full.
+    int GetSwapSlot(unsigned vpn);
+
+    /// Copy the contents of page `vpn` into the frame `ppn`, and map it.
+    void FillFrame(unsigned vpn, unsigned ppn);
+
+    /// Whether page `vpn` holds only code, so it can be shared.
+    bool IsCodePage(unsigned vpn) const;
+
+    /// If another address space has the code page `vpn` in memory, map
+    /// the same frame, pinned, and return its number; otherwise return -1.
+    int MapSharedPage(unsigned vpn);
+
+    /// If page `vpn` was never written and is not in the executable, map
+    /// the frame of zeroes, read-only, and return true.
+    bool MapZeroPage(unsigned vpn);
+
+    /// Load the pages near `vpn` that are not in memory into free frames.
+    void FaultAround(unsigned vpn);
+
+    /// Whether page `vpn` can be saved along with a neighbour.
+    bool IsClusterable(unsigned vpn) const;
+
+    /// Save page `vpn`, held in frame `ppn`, and its modified neighbours.
+    void WriteCluster(unsigned vpn, unsigned ppn);
+
+    /// Give the `count` pages from `first` consecutive swap slots, and
+    /// return the first one, or -1 if there is no free run that long.
+    int GetSwapRun(unsigned first, unsigned count);
+
+    /// First page of the area of mapped files; the stack ends before it,
+    /// and the heap starts after it.
+    unsigned mmapFirstPage;
+
+    /// Mapping that each page belongs to, or null.  Mapped pages are read
+    /// from and saved to their file, never to swap.
+    MappedFile **mapping;
+
+    /// Read or write page `vpn`, held at `data`, from or to its file.
+    void ReadMappedPage(unsigned vpn, char *data);
+    void WriteMappedPage(unsigned vpn, const char *data);
+
+    /// Two-level page table, walked on every TLB miss.
+    PageTable pageTable;
+
+    /// Whether an eviction may have left a second-level table with no
+    /// valid pages.
+    bool tablesToReclaim;
+
+    /// Whether the constructor for `Fork` copied every page.
+    bool complete;
+
+    /// Free the second-level tables with no pages in memory nor being
+    /// evicted.  Only called by the thread of this address space, while it
+    /// holds no pointer to any entry.
+    void ReclaimTables();
+    #else
     /// Assume linear page table translation for now!
     TranslationEntry *pageTable;
+    #endif
 
     /// Number of pages in the virtual address space.
     unsigned numPages;
@@ -28,7 +28,16 @@
 #include "threads/system.hh"
 #include "args.hh"
 #include "lib/utility.hh"
+#ifdef USE_TLB
+#include "vmem/core_map.hh"
+#include "vmem/load_control.hh"
+#endif
+#ifdef FILESYS
+#include "filesys/directory.hh"
+#include "filesys/file_header.hh"
+#endif
 #include <stdio.h>
+#include <string.h>
 
 static void
 IncrementPC()
@@ -84,6 +93,35 @@ StartProcess(void *args){
     machine->Run();
 }
 
+#ifdef USE_TLB
+/// Start running the child created by `Fork`, from the registers that the
+/// parent had when it called it, in `args`.
+static void
+ForkedProcess(void *args){
+    int *registers = (int *) args;
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++)
+        machine->WriteRegister(i, registers[i]);
+    delete [] registers;
+
+    currentThread->space->RestoreState();
+    machine->Run();
+}
+
+/// End the user program of the current thread.  A joinable thread is only
+/// destroyed after it is joined, so its memory, mapped files and swap are
+/// given back now.  Saving the mapped files may wait for the disk, which
+/// can not be done once the thread is finished.
+static void
+FinishProcess(){
+    currentThread->space->PrintPagingStats();
+    if(loadControl != nullptr)
+        loadControl->Remove(currentThread->space);
+    currentThread->space->ReleaseFrames();
+    currentThread->space->ReleaseSwap();
+    currentThread->Finish();
+}
+#endif
+
 /// Handle a system call exception.
 ///
 /// * `et` is the kind of exception.  The list of possible exceptions is in
@@ -101,6 +139,41 @@ StartProcess(void *args){
 /// And do not forget to increment the program counter before returning. (Or
 /// else you will loop making the same system call forever!)
 
+#ifdef FILESYS
+/// Maximum number of names returned by a single `ReadDir`.
+static const unsigned READDIR_MAX_ENTRIES = 16;
+
+/// Copy to user memory at `userAddress` the names of the directory open in
+/// `file` that fit in `size` bytes, starting from the position `*cookie`,
+/// and advance it.  Return the number of bytes copied, or -1 if `*cookie`
+/// is not a position in the directory.
+static int
+ReadDirToUser(OpenFile *file, int userAddress, unsigned size, unsigned *cookie)
+{
+    unsigned maxEntries = size / (FILE_NAME_MAX_LEN + 1);
+    if (maxEntries > READDIR_MAX_ENTRIES)
+        maxEntries = READDIR_MAX_ENTRIES;
+
+    DirectoryEntry entries[READDIR_MAX_ENTRIES];
+    int count = Directory::ReadEntriesFrom(file, cookie, entries,
+                                           maxEntries);
+    if (count < 0)
+        return -1;
+
+    char buffer[READDIR_MAX_ENTRIES * (FILE_NAME_MAX_LEN + 1)];
+    unsigned length = 0;
+    for (int i = 0; i < count; i++) {
+        unsigned n = strnlen(entries[i].name, FILE_NAME_MAX_LEN);
+        memcpy(&buffer[length], entries[i].name, n);
+        buffer[length + n] = '\0';
+        length += n + 1;
+    }
+    if (length > 0)
+        WriteBufferToUser(buffer, userAddress, length);
+    return length;
+}
+#endif
+
 /// This implementeation must be BULLET PROOF. It can't break NACHOS.
 static void
 SyscallHandler(ExceptionType _et)
@@ -174,9 +247,9 @@ SyscallHandler(ExceptionType _et)
             } 
             
             else {    
-                char buffer[size+1];
                 DEBUG('e', "`Read` requested for file id %u.\n", fid);
                 if(fid == CONSOLE_INPUT){
+                    char buffer[size+1];
                     for(; count < size; count++) buffer[count] = synchConsole->Read();
                     WriteBufferToUser(buffer, usrAddr, size);
                 }
@@ -186,18 +259,14 @@ SyscallHandler(ExceptionType _et)
                     OpenFile *file = currentThread->GetFile(fid);
                     if(file == nullptr){
                         DEBUG('e', "Error: file with %d was not opened correctly.\n", fid);
+                    } else if(pos < -1){
+                        // Only -1 means the current position of the file.
+                        DEBUG('e', "Error: invalid position %d.\n", pos);
                     } else {
-                        if(pos != -1){
-                            count = file->ReadAt(buffer, size, pos);
-
-                        } else{
-                            count = file->Read(buffer, size);
-                        }
+                        // Straight into the pages of the buffer.
+                        count = ReadFileToUser(file, usrAddr, size, pos);
                         if(count < size)
-                            DEBUG('e', "Error: Expecting %d bytes from file %d and read %d bytes\n",size,fid,count);
-                        else{
-                            WriteBufferToUser(buffer, usrAddr, size);
-                        }
+                            DEBUG('e', "Expecting %d bytes from file %d and read %d bytes\n",size,fid,count);
                     }
                 }                                 
             }
@@ -222,15 +291,17 @@ SyscallHandler(ExceptionType _et)
             else{
             DEBUG('e',"Write requested, file id: %d\n",fid);
 
-            char buffer[size];
-            ReadBufferFromUser(usrAddr, buffer, size);
-
             if(fid == CONSOLE_OUTPUT){
+                char buffer[size];
+                ReadBufferFromUser(usrAddr, buffer, size);
                 for (; count < size; count++){
                     synchConsole->Write(buffer[count]);
                 }                
+            } else if(currentThread->GetFile(fid) == nullptr){
+                DEBUG('e', "Error: file with %d was not opened correctly.\n", fid);
             } else{
-                count = currentThread->GetFile(fid)->Write(buffer,size);
+                // Straight from the pages of the buffer.
+                count = WriteFileFromUser(currentThread->GetFile(fid), usrAddr, size);
             }
             }  
         machine->WriteRegister(2,count);
@@ -268,14 +339,11 @@ SyscallHandler(ExceptionType _et)
         case SC_EXIT:{
             int status = machine->ReadRegister(4);
             DEBUG('e', "Exited thread with status %d\n", status);            
-                #ifdef VMEM
-                char *buffer = new char [20];
-                sprintf(buffer,"SWAP.%d",currentThread->GetProcessId());
-                fileSystem->Remove(buffer);
-                delete currentThread->space->swapFile; 
-                delete [] buffer;
-            #endif
+            #ifdef USE_TLB
+            FinishProcess();
+            #else
             currentThread->Finish();
+            #endif
             break;
         }
 
@@ -348,6 +416,10 @@ SyscallHandler(ExceptionType _et)
                     }
                     else{
                         t->space = addrSpace;
+                        #ifdef USE_TLB
+                        if(loadControl != nullptr)
+                            loadControl->Admit(addrSpace);
+                        #endif
                         DEBUG('e',"New thread created to run the executable %s with pid: %d and space address: %p\n", filename, t->GetProcessId(),addrSpace);
                         machine->WriteRegister(2,pid);
                         t->Fork(StartProcess, argsv);
@@ -357,6 +429,172 @@ SyscallHandler(ExceptionType _et)
             break;
         }
 
+        /// Create a copy of this user program; the child gets 0 as result.
+        // SpaceId Fork(void);
+        case SC_FORK: {
+            machine->WriteRegister(2,-1);
+#ifdef USE_TLB
+            unsigned dirSector = 1;
+            #ifdef DIRECTORY
+                dirSector = currentThread->GetDirSector();
+            #endif
+
+            Thread *t = new Thread(currentThread->GetName(),true,currentThread->GetPriority(),dirSector);
+            SpaceId pid = t->GetProcessId();
+            t->space = new AddressSpace(currentThread->space, pid);
+            // The pages of the parent in swap did not fit in it again.
+            if(!t->space->IsComplete()){
+                DEBUG('e',"Error: not enough swap for the child.\n");
+                delete t;
+                break;
+            }
+            if(loadControl != nullptr)
+                loadControl->Admit(t->space);
+
+            // The child resumes after the system call, with 0 as result.
+            int *registers = new int [NUM_TOTAL_REGS];
+            for (unsigned i = 0; i < NUM_TOTAL_REGS; i++)
+                registers[i] = machine->ReadRegister(i);
+            registers[PREV_PC_REG] = registers[PC_REG];
+            registers[PC_REG] = registers[NEXT_PC_REG];
+            registers[NEXT_PC_REG] += 4;
+            registers[2] = 0;
+
+            DEBUG('e',"`Fork` of %s created process with pid: %d\n", currentThread->GetName(), pid);
+            machine->WriteRegister(2,pid);
+            t->Fork(ForkedProcess, registers);
+#else
+            DEBUG('e', "Error: `Fork` needs demand paging.\n");
+#endif
+            break;
+        }
+
+        /// Read the names in a directory, a batch at a time.
+        // int ReadDir(OpenFileId id, char *buffer, int size, int *cookie);
+        case SC_READDIR: {
+            int count      = -1;
+
+#ifdef FILESYS
+            OpenFileId fid = machine->ReadRegister(4);
+            int usrAddr    = machine->ReadRegister(5);
+            int size       = machine->ReadRegister(6);
+            int cookieAddr = machine->ReadRegister(7);
+            int cookie;
+            if(fid < 2 || !currentThread->HasOpenFile(fid)){
+                DEBUG('e', "Error: the file %d is not opened.\n", fid);
+            }
+            else if(!currentThread->GetFile(fid)->GetHeader()->IsDirectory()){
+                DEBUG('e', "Error: the file %d is not a directory.\n", fid);
+            }
+            else if(usrAddr == 0 || size < (int) FILE_NAME_MAX_LEN + 1){
+                DEBUG('e', "Error: no room in the buffer for a name.\n");
+            }
+            else if(cookieAddr == 0 || !SafeReadMem(cookieAddr, 4, &cookie)){
+                DEBUG('e', "Error: invalid cookie address.\n");
+            }
+            else {
+                DEBUG('e', "`ReadDir` requested for file id %d.\n", fid);
+                unsigned cursor = cookie;
+                count = ReadDirToUser(currentThread->GetFile(fid), usrAddr,
+                                      size, &cursor);
+                if(count < 0)
+                    DEBUG('e', "Error: invalid cookie %d.\n", cookie);
+                else
+                    SafeWriteMem(cookieAddr, 4, cursor);
+            }
+#else
+            DEBUG('e', "Error: `ReadDir` needs the Nachos file system.\n");
+#endif
+            machine->WriteRegister(2, count);
+            break;
+        }
+
+        /// Map part of an open file into memory.
+        // int Mmap(OpenFileId id, int offset, int length);
+        case SC_MMAP: {
+            int address    = -1;
+#ifdef USE_TLB
+            OpenFileId fid = machine->ReadRegister(4);
+            int offset     = machine->ReadRegister(5);
+            int length     = machine->ReadRegister(6);
+            if(fid < 2 || !currentThread->HasOpenFile(fid)){
+                DEBUG('e', "Error: the file %d is not opened.\n", fid);
+            }
+            else if(offset < 0 || offset % PAGE_SIZE != 0 || length <= 0){
+                DEBUG('e', "Error: invalid offset %d or length %d.\n", offset, length);
+            }
+            else {
+                DEBUG('e', "`Mmap` requested for %d bytes at %d of file id %d.\n",
+                      length, offset, fid);
+                address = currentThread->space->Map(currentThread->GetFile(fid),
+                                                    offset, length);
+                if(address < 0)
+                    DEBUG('e', "Error: no room to map %d bytes.\n", length);
+            }
+#else
+            DEBUG('e', "Error: `Mmap` needs demand paging.\n");
+#endif
+            machine->WriteRegister(2, address);
+            break;
+        }
+
+        /// Remove a mapping made by `Mmap`, saving its modified pages.
+        // int Munmap(int address);
+        case SC_MUNMAP: {
+            int result  = -1;
+#ifdef USE_TLB
+            int address = machine->ReadRegister(4);
+            DEBUG('e', "`Munmap` requested for address %d.\n", address);
+            if(currentThread->space->Unmap(address))
+                result = 0;
+            else
+                DEBUG('e', "Error: no mapping starts at %d.\n", address);
+#else
+            DEBUG('e', "Error: `Munmap` needs demand paging.\n");
+#endif
+            machine->WriteRegister(2, result);
+            break;
+        }
+
+        /// Grow the heap `increment` bytes; return its previous end.
+        // int Sbrk(int increment);
+        case SC_SBRK: {
+            int increment = machine->ReadRegister(4);
+            int address   = -1;
+            DEBUG('e', "`Sbrk` requested for %d bytes.\n", increment);
+            if(increment < 0)
+                DEBUG('e', "Error: the heap can not shrink.\n");
+            else if((address = currentThread->space->Sbrk(increment)) < 0)
+                DEBUG('e', "Error: no room for %d more bytes of heap.\n", increment);
+            machine->WriteRegister(2, address);
+            break;
+        }
+
+        /// Copy the paging events of the process to user memory.
+        // int GetPagingStats(PagingStats *stats);
+        case SC_PAGINGSTATS: {
+            int address = machine->ReadRegister(4);
+            DEBUG('e', "`GetPagingStats` requested.\n");
+            if(address == 0){
+                DEBUG('e', "Error: address to statistics is null.\n");
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            const PagingStats *paging = currentThread->space->GetPagingStats();
+            const unsigned counters[] = {
+                paging->tlbMisses, paging->pageFaults, paging->swapIns,
+                paging->swapOuts, paging->zeroFills, paging->evictions
+            };
+            static_assert(sizeof counters == sizeof (PagingStats),
+                          "every field of `PagingStats` must be copied");
+            int result = 0;
+            for(unsigned i = 0; i < sizeof counters / sizeof *counters; i++)
+                if(!SafeWriteMem(address + i * 4, 4, counters[i]))
+                    result = -1;
+            machine->WriteRegister(2, result);
+            break;
+        }
+
         default:
             fprintf(stderr, "Unexpected system call: id %d.\n", scid);
             ASSERT(false);
@@ -372,28 +610,79 @@ DebugTLBEntryInfo(TranslationEntry entry){
     DEBUG('k', "VP: %d - PP: %d - VALID: %d\n",entry.virtualPage, entry.physicalPage, entry.valid);
 }
 
+/// The TLB keeps entries of every address space, so the one replaced may
+/// not belong to the running process.  Keep its use and dirty bits in the
+/// page table of its owner, or with the page if it is shared, before losing
+/// them.
+static void
+SaveTLBEntry(const TranslationEntry *entry){
+    // The frame of zeroes is never written, and its use bit is not needed.
+    if(!entry->valid || coreMap->IsZeroFrame(entry->physicalPage))
+        return;
+    TranslationEntry *page = coreMap->GetPage(entry->physicalPage);
+    ASSERT(page != nullptr);
+    page->use   = page->use   || entry->use;
+    page->dirty = page->dirty || entry->dirty;
+}
+
 static void
 PageFaultHandler(ExceptionType _et){
      unsigned vaddr = machine->ReadRegister(BAD_VADDR_REG);
      unsigned vpn = vaddr / PAGE_SIZE;
-     unsigned i = machine->GetMMU()->GetNextIdx();
 
     TranslationEntry *tlb = machine->GetMMU()->tlb;
-    TranslationEntry *pageTable = currentThread->space->GetPageTable();
+    PageTable *pageTable = currentThread->space->GetPageTable();
+    TranslationEntry entry;
+    PagingStats *paging = currentThread->space->GetPagingStats();
+    paging->tlbMisses++;
+
+    // Between the stack and the mapped files, or past them.
+    if(!currentThread->space->IsAddressable(vpn)){
+        DEBUG('k',"Access to unmapped page %u.\n", vpn);
+        FinishProcess();
+        return;
+    }
 
-    if(!pageTable[vpn].valid){
+    if(!pageTable->IsValid(vpn)){
         DEBUG('k',"Requested page is invalid. Loading page...\n");
-        tlb[i] = currentThread->space->LoadPage(vpn);
+        // A suspended program stops here until load control resumes it.
+        if(loadControl != nullptr)
+            loadControl->PageFault(currentThread->space);
+        stats->numPageFaults++;
+        paging->pageFaults++;
+        unsigned long start = stats->totalTicks;
+        bool loaded = currentThread->space->LoadPage(vpn);
+        stats->RecordFaultLatency(stats->totalTicks - start);
+        // No page could be evicted to make room: swap is full.
+        if(!loaded){
+            FinishProcess();
+            return;
+        }
+        entry = *pageTable->Find(vpn);
     } else{
         DEBUG('k',"Requested page is valid. Copying page to user's page table...\n");
 	    currentThread->space->SaveState();
-        tlb[i] = pageTable[vpn];
+        stats->numPageHits++;
+        entry = *pageTable->Find(vpn);
     }
+
+    // Loading the page may have let other threads run, so the slot is
+    // chosen afterwards.
+    unsigned i = machine->GetMMU()->GetNextIdx(vpn);
+    SaveTLBEntry(&tlb[i]);
+    tlb[i] = entry;
 }
 
+/// A write to a page shared after a `Fork` gives the process its own copy,
+/// and the instruction is executed again.  Any other write to a read-only
+/// page kills the process, and so does running out of swap for the copy.
 static void
 ReadOnlyHandler(ExceptionType _et){
-    currentThread->Finish();
+    unsigned vpn = machine->ReadRegister(BAD_VADDR_REG) / PAGE_SIZE;
+    if(currentThread->space->CopyOnWrite(vpn))
+        return;
+    DEBUG('k',"Write to read-only page %u.\n", vpn);
+    FinishProcess();
 }
 
 #endif
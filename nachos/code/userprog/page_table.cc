@@ -0,0 +1,115 @@
+/// Routines to manage two-level page tables.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "page_table.hh"
+#include "lib/utility.hh"
+#include "threads/system.hh"
+
+
+PageTable::PageTable(int asid_)
+{
+    asid      = asid_;
+    numPages  = 0;
+    directory = nullptr;
+}
+
+PageTable::~PageTable()
+{
+    for (unsigned i = 0; i < GetNumTables(); i++)
+        delete [] directory[i];
+    delete [] directory;
+}
+
+/* Las entradas de una tabla nueva son invalidas; las completa quien carga
+   cada pagina. */
+TranslationEntry &
+PageTable::operator[](unsigned vpn)
+{
+    ASSERT(vpn < numPages);
+
+    TranslationEntry *&table = directory[vpn / PAGE_TABLE_ENTRIES];
+    if (table == nullptr) {
+        unsigned first = vpn - vpn % PAGE_TABLE_ENTRIES;
+        table = new TranslationEntry [PAGE_TABLE_ENTRIES];
+        for (unsigned i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+            table[i].virtualPage  = first + i;
+            table[i].physicalPage = numPages + 1;
+            table[i].valid        = false;
+            table[i].readOnly     = false;
+            table[i].use          = false;
+            table[i].dirty        = false;
+            table[i].asid         = asid;
+        }
+        stats->numPageTablesCreated++;
+    }
+    return table[vpn % PAGE_TABLE_ENTRIES];
+}
+
+TranslationEntry *
+PageTable::Find(unsigned vpn) const
+{
+    ASSERT(vpn < numPages);
+
+    TranslationEntry *table = directory[vpn / PAGE_TABLE_ENTRIES];
+    return table == nullptr ? nullptr : &table[vpn % PAGE_TABLE_ENTRIES];
+}
+
+bool
+PageTable::IsValid(unsigned vpn) const
+{
+    const TranslationEntry *entry = Find(vpn);
+    return entry != nullptr && entry->valid;
+}
+
+/* Solo se agranda el directorio. */
+void
+PageTable::Resize(unsigned npages)
+{
+    ASSERT(npages >= numPages);
+
+    unsigned oldTables = GetNumTables();
+    unsigned newTables = DivRoundUp(npages, PAGE_TABLE_ENTRIES);
+    if (newTables > oldTables) {
+        TranslationEntry **resized = new TranslationEntry *[newTables];
+        for (unsigned i = 0; i < oldTables; i++)
+            resized[i] = directory[i];
+        for (unsigned i = oldTables; i < newTables; i++)
+            resized[i] = nullptr;
+        delete [] directory;
+        directory = resized;
+    }
+    numPages = npages;
+}
+
+unsigned
+PageTable::GetNumPages() const
+{
+    return numPages;
+}
+
+unsigned
+PageTable::GetNumTables() const
+{
+    return DivRoundUp(numPages, PAGE_TABLE_ENTRIES);
+}
+
+bool
+PageTable::Reclaim(unsigned table)
+{
+    ASSERT(table < GetNumTables());
+
+    TranslationEntry *entries = directory[table];
+    if (entries == nullptr)
+        return false;
+    for (unsigned i = 0; i < PAGE_TABLE_ENTRIES; i++)
+        if (entries[i].valid)
+            return false;
+    delete [] entries;
+    directory[table] = nullptr;
+    stats->numPageTablesReclaimed++;
+    return true;
+}
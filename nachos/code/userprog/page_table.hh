@@ -0,0 +1,69 @@
+/// Data structures for the two-level page tables of address spaces with
+/// demand paging.
+///
+/// A flat table needs an entry for every page of the address space, even for
+/// the ones that are never used, like most of the area reserved for `Mmap`.
+/// Here a directory has a pointer for every `PAGE_TABLE_ENTRIES` pages, to a
+/// second-level table that is created the first time one of them is needed,
+/// and that can be freed again once none of them is in memory: the entry of
+/// a page that is not valid holds nothing that can not be rebuilt.
+///
+/// Second-level tables never move, so the core map can keep pointing to
+/// their entries while the address space grows.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_PAGETABLE__HH
+#define NACHOS_USERPROG_PAGETABLE__HH
+
+
+#include "machine/translation_entry.hh"
+
+
+/// Number of entries of each second-level table.
+const unsigned PAGE_TABLE_ENTRIES = 32;
+
+class PageTable {
+public:
+
+    /// Create an empty page table for the address space `asid`.
+    PageTable(int asid);
+
+    ~PageTable();
+
+    /// The entry of page `vpn`; its second-level table is created if it
+    /// does not exist yet.
+    TranslationEntry &operator[](unsigned vpn);
+
+    /// The entry of page `vpn`, or null if its second-level table does not
+    /// exist, which means that the page is not valid.
+    TranslationEntry *Find(unsigned vpn) const;
+
+    /// Whether page `vpn` is mapped to a frame.
+    bool IsValid(unsigned vpn) const;
+
+    /// Make room for `npages` pages, which can only grow.  Existing
+    /// second-level tables stay where they are.
+    void Resize(unsigned npages);
+
+    /// Number of pages, and of second-level tables that would cover them.
+    unsigned GetNumPages() const;
+    unsigned GetNumTables() const;
+
+    /// Free the second-level table `table` if it exists and none of its
+    /// pages is valid.  Return whether it was freed.
+    bool Reclaim(unsigned table);
+
+private:
+
+    int asid;
+    unsigned numPages;
+
+    /// A pointer for every second-level table, null if it does not exist.
+    TranslationEntry **directory;
+};
+
+
+#endif
@@ -1,6 +1,9 @@
 #include "machine/console.hh"
 #include "threads/synch.hh"
 #include "threads/system.hh"
+#ifdef USE_TLB
+#include "vmem/load_control.hh"
+#endif
 // #include "synch_console.hh"
 #include <stdio.h>
 
@@ -21,6 +24,10 @@ StartProcess(const char *filename)
 
     AddressSpace *space = new AddressSpace(executable, currentThread->GetProcessId());
     currentThread->space = space;
+#ifdef USE_TLB
+    if (loadControl != nullptr)
+        loadControl->Admit(space);
+#endif
 
     // delete executable;
 
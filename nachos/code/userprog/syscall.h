@@ -31,6 +31,11 @@
 #define SC_CLOSE   13
 #define SC_READ    14
 #define SC_WRITE   15
+#define SC_READDIR 16
+#define SC_MMAP    17
+#define SC_MUNMAP  18
+#define SC_SBRK    19
+#define SC_PAGINGSTATS 20
 
 
 #ifndef IN_ASM
@@ -65,13 +70,17 @@ SpaceId Exec(char *name, char** argv, int isJoinable);
 /// Return the exit status.
 int Join(SpaceId id);
 
+/// Create a new user program, a copy of the current one that continues from
+/// the return of this call.  Return the identifier of the child in the
+/// parent, 0 in the child, or -1 on error.
+///
+/// Memory is copied lazily: both programs share their pages until one of
+/// them writes to a page.  Open files are not inherited.
+SpaceId Fork(void);
 
-/// User-level thread operations: `Fork` and `Yield`.  To allow multiple
-/// threads to run within a user program.
 
-/// Fork a thread to run a procedure (`func`) in the *same* address space as
-/// the current thread.
-int Fork(void (*func)(void));
+/// User-level thread operations: `Yield`.  To allow multiple threads to run
+/// within a user program.
 
 /// Yield the CPU to another runnable thread, whether in this address space
 /// or not.
@@ -122,6 +131,66 @@ int Read(char *buffer, int size, OpenFileId id, int pos);
 /// Close the file, we are done reading and writing to it.
 int Close(OpenFileId id);
 
+/// Read the names of the files in the directory open as `id`.
+///
+/// The names are stored one after the other in `buffer`, each one followed
+/// by a null character, as many as fit in `size` bytes.  `*cookie` records
+/// where the listing continues: set it to 0 before the first call, and pass
+/// it back unchanged in the following ones.
+///
+/// Return the number of bytes stored in `buffer`, 0 once every name was
+/// returned, or -1 on error (for example, if `id` is not a directory).
+int ReadDir(OpenFileId id, char *buffer, int size, int *cookie);
+
+
+/// Memory mapped files: `Mmap` and `Munmap`.
+
+/// Map `length` bytes of the open file `id`, starting at position `offset`,
+/// which must be a multiple of the page size, into the address space.
+///
+/// Return the address where the bytes are mapped, or -1 on error.  Pages
+/// are read from the file the first time they are used; the ones that were
+/// modified are written back when they are evicted, when they are unmapped,
+/// and when the program exits.  Writing past the end of the file makes it
+/// grow.  Closing `id` does not remove the mapping, and `Fork` does not copy
+/// it to the child.
+int Mmap(OpenFileId id, int offset, int length);
+
+/// Remove the mapping that starts at `address`, as returned by `Mmap`.
+///
+/// Return 0 on success, or -1 if no mapping starts there.
+int Munmap(int address);
+
+
+/// Dynamic memory: `Sbrk`.
+
+/// Move the end of the heap, the last area of the address space, `increment`
+/// bytes up, and return the address where it was; `Sbrk(0)` returns the
+/// current end.
+///
+/// The new bytes start as zeroes.  The heap can not shrink; return -1 if
+/// `increment` is negative, or if the heap can not grow that much.
+int Sbrk(int increment);
+
+
+/// Paging statistics: `GetPagingStats`.
+
+/// Paging events of a process since it started.
+typedef struct {
+    unsigned tlbMisses;   ///< Translations not found in the TLB.
+    unsigned pageFaults;  ///< Misses on pages that were not in memory.
+    unsigned swapIns;     ///< Pages read from swap.
+    unsigned swapOuts;    ///< Pages written to swap.
+    unsigned zeroFills;   ///< Frames given to pages never written, zeroed.
+    unsigned evictions;   ///< Pages taken out of memory, by any process.
+} PagingStats;
+
+/// Store in `stats` the paging events of the calling process.  They are
+/// also printed when it exits.
+///
+/// Return 0 on success, or -1 on error.
+int GetPagingStats(PagingStats *stats);
+
 
 #endif
 
@@ -4,6 +4,7 @@
 
 
 #include "transfer.hh"
+#include "filesys/open_file.hh"
 #include "lib/utility.hh"
 #include "threads/system.hh"
 
@@ -11,10 +12,10 @@
 
 bool SafeReadMem(unsigned userAddress, unsigned size, int* buffer){
 
-    if(machine->ReadMem(userAddress, size, buffer, true)) return true;
+    if(machine->ReadMem(userAddress, size, buffer)) return true;
 
     for(unsigned i = 1; i < MAX_PAGE_FAULTS; i++)
-        if(machine->ReadMem(userAddress, size, buffer,false))
+        if(machine->ReadMem(userAddress, size, buffer))
             return true;
     return false;
 }
@@ -81,4 +82,61 @@ void WriteStringToUser(const char *string, int userAddress)
      while (*string != '\0'){
         ASSERT(SafeWriteMem(userAddress++, 1, *string++));
     }
-}
\ No newline at end of file
+}
+
+/* Cada pedazo va de la posicion actual hasta el final de su pagina, que
+   queda fijada mientras se lee o escribe el archivo: aunque el sistema de
+   archivos ceda el procesador esperando al disco, nadie la desaloja, y no
+   hace falta copiarla a un buffer del kernel. */
+unsigned ReadFileToUser(OpenFile *file, int userAddress, unsigned size,
+                        int position)
+{
+    ASSERT(file != nullptr);
+
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    unsigned done = 0;
+    while (done < size) {
+        unsigned address = userAddress + done;
+        unsigned offset  = address % PAGE_SIZE;
+        unsigned chunk   = size - done < PAGE_SIZE - offset
+                           ? size - done : PAGE_SIZE - offset;
+        int ppn = currentThread->space->PinPage(address / PAGE_SIZE, true);
+        if (ppn < 0)
+            break;
+        char *data = &mainMemory[ppn * PAGE_SIZE + offset];
+        int count = position == -1 ? file->Read(data, chunk)
+                                   : file->ReadAt(data, chunk, position + done);
+        currentThread->space->UnpinPage(ppn);
+        if (count <= 0)
+            break;
+        done += count;
+        if ((unsigned) count < chunk)
+            break;
+    }
+    return done;
+}
+
+unsigned WriteFileFromUser(OpenFile *file, int userAddress, unsigned size)
+{
+    ASSERT(file != nullptr);
+
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    unsigned done = 0;
+    while (done < size) {
+        unsigned address = userAddress + done;
+        unsigned offset  = address % PAGE_SIZE;
+        unsigned chunk   = size - done < PAGE_SIZE - offset
+                           ? size - done : PAGE_SIZE - offset;
+        int ppn = currentThread->space->PinPage(address / PAGE_SIZE, false);
+        if (ppn < 0)
+            break;
+        int count = file->Write(&mainMemory[ppn * PAGE_SIZE + offset], chunk);
+        currentThread->space->UnpinPage(ppn);
+        if (count <= 0)
+            break;
+        done += count;
+        if ((unsigned) count < chunk)
+            break;
+    }
+    return done;
+}
@@ -26,5 +26,19 @@ void WriteStringToUser(const char *string, int userAddress);
 bool SafeReadMem(unsigned userAddress, unsigned size, int* buffer);
 
 bool SafeWriteMem(unsigned userAddress, unsigned size, int value);
+
+class OpenFile;
+
+/// Read up to `size` bytes of `file` straight into user memory at
+/// `userAddress`, a page at a time with its frame pinned.  Read from
+/// `position`, or from the current position of the file if it is -1.
+/// Return the number of bytes read, which is less than `size` if the file
+/// ends or the buffer leaves the address space.
+unsigned ReadFileToUser(OpenFile *file, int userAddress, unsigned size,
+                        int position);
+
+/// Write `size` bytes of user memory at `userAddress` to `file`, a page at
+/// a time with its frame pinned.  Return the number of bytes written.
+unsigned WriteFileFromUser(OpenFile *file, int userAddress, unsigned size);
 #endif
     
\ No newline at end of file
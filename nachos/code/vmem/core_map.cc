@@ -0,0 +1,681 @@
+/// Routines to manage the core map.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "core_map.hh"
+#include "lib/bitmap.hh"
+#include "threads/system.hh"
+#include "threads/synch.hh"
+#include "userprog/address_space.hh"
+
+#include <string.h>
+
+
+CoreMap::CoreMap(unsigned nframes, PagePolicy policy_)
+{
+    ASSERT(nframes > 0);
+
+    numFrames = nframes;
+    policy    = policy_;
+    entries   = new CoreMapEntry [numFrames];
+    for (unsigned i = 0; i < numFrames; i++) {
+        entries[i].space   = nullptr;
+        entries[i].page    = nullptr;
+        entries[i].pinned  = 0;
+        entries[i].queued  = false;
+        entries[i].age     = 0;
+        entries[i].lastUse = 0;
+        entries[i].file    = -1;
+        entries[i].sharers = nullptr;
+        entries[i].numSharers = 0;
+    }
+    hand    = 0;
+    victims = new List<unsigned>;
+    lowWatermark  = 0;
+    highWatermark = 0;
+    pageoutWakeup = nullptr;
+    pageoutAwake  = false;
+    frameWaiters   = 0;
+    frameLock      = new Lock("frame");
+    frameAvailable = new Condition("frame available", frameLock);
+
+    // The frame of zeroes has no page, so no replacement policy picks it.
+    zeroFrame = -1;
+#ifdef USE_TLB
+    zeroFrame = freeMemMap->Find();
+    ASSERT(zeroFrame >= 0);
+    memset(&machine->GetMMU()->mainMemory[zeroFrame * PAGE_SIZE], 0,
+           PAGE_SIZE);
+#endif
+
+    stats->pagePolicy = GetPolicyName();
+}
+
+CoreMap::~CoreMap()
+{
+    for (unsigned i = 0; i < numFrames; i++)
+        delete entries[i].sharers;
+    delete [] entries;
+    delete victims;
+    delete pageoutWakeup;
+    delete frameAvailable;
+    delete frameLock;
+}
+
+/* Toma un marco libre de `freeMemMap` y registra a quién pertenece.  En
+   FIFO el marco vuelve a la cola sólo si no estaba ya en ella, así que
+   conserva su lugar original.  Para las demás políticas la página cuenta
+   como recién usada. */
+int
+CoreMap::Find(AddressSpace *space, TranslationEntry *page)
+{
+    ASSERT(space != nullptr);
+    ASSERT(page != nullptr);
+
+    int frame = freeMemMap->Find();
+    if (frame < 0)
+        return -1;
+
+    entries[frame].space   = space;
+    entries[frame].page    = page;
+    entries[frame].pinned  = 1;
+    entries[frame].age     = 0x80;
+    entries[frame].lastUse = stats->totalTicks;
+    if (policy == PAGE_FIFO && !entries[frame].queued) {
+        victims->Append(frame);
+        entries[frame].queued = true;
+    }
+    if (IsMemoryLow() && !pageoutAwake) {
+        pageoutAwake = true;
+        pageoutWakeup->V();
+    }
+    return frame;
+}
+
+bool
+CoreMap::IsMemoryLow() const
+{
+    return freeMemMap->CountClear() < lowWatermark;
+}
+
+void
+CoreMap::Release(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    entries[frame].space  = nullptr;
+    entries[frame].page   = nullptr;
+    entries[frame].pinned = 0;
+    entries[frame].file   = -1;
+    delete entries[frame].sharers;
+    entries[frame].sharers = nullptr;
+    entries[frame].numSharers = 0;
+    freeMemMap->Clear(frame);
+    NotifyFrame();
+}
+
+/* Con pocos marcos, recorrerlos todos es más barato que mantener una tabla
+   aparte indexada por ejecutable y página. */
+int
+CoreMap::FindShared(int file, unsigned vpn, AddressSpace *space)
+{
+    ASSERT(space != nullptr);
+
+    for (unsigned frame = 0; frame < numFrames; frame++)
+        if (entries[frame].file == file
+              && entries[frame].shared.virtualPage == vpn) {
+            AddSharer(frame, space);
+            entries[frame].pinned++;
+            return frame;
+        }
+    return -1;
+}
+
+bool
+CoreMap::MakeShared(unsigned frame, int file, unsigned vpn)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(file >= 0);
+
+    for (unsigned i = 0; i < numFrames; i++)
+        if (entries[i].file == file && entries[i].shared.virtualPage == vpn)
+            return false;
+
+    Share(frame);
+    entries[frame].file = file;
+    return true;
+}
+
+/* La traducción del dueño pasa a ser la común; desde ahí se toman los bits
+   de uso y modificación de la página. */
+void
+CoreMap::Share(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(entries[frame].space != nullptr);
+
+    entries[frame].shared     = *entries[frame].page;
+    entries[frame].page       = &entries[frame].shared;
+    entries[frame].sharers    = new List<AddressSpace *>;
+    entries[frame].sharers->Append(entries[frame].space);
+    entries[frame].numSharers = 1;
+    entries[frame].space      = nullptr;
+}
+
+void
+CoreMap::AddSharer(unsigned frame, AddressSpace *space)
+{
+    ASSERT(IsShared(frame));
+    ASSERT(space != nullptr);
+
+    entries[frame].sharers->Append(space);
+    entries[frame].numSharers++;
+}
+
+void
+CoreMap::Unshare(unsigned frame, AddressSpace *space)
+{
+    ASSERT(IsShared(frame));
+    ASSERT(space != nullptr);
+
+    entries[frame].sharers->Remove(space);
+    if (--entries[frame].numSharers == 0)
+        Release(frame);
+}
+
+/* El único espacio que queda se vuelve dueño del marco, y su entrada en la
+   tabla de páginas recibe los bits de la traducción común. */
+void
+CoreMap::MakePrivate(unsigned frame, AddressSpace *space,
+                     TranslationEntry *page)
+{
+    ASSERT(IsShared(frame));
+    ASSERT(entries[frame].numSharers == 1);
+    ASSERT(space != nullptr);
+    ASSERT(page != nullptr);
+
+    page->use   = page->use   || entries[frame].shared.use;
+    page->dirty = page->dirty || entries[frame].shared.dirty;
+    entries[frame].space      = space;
+    entries[frame].page       = page;
+    entries[frame].file       = -1;
+    delete entries[frame].sharers;
+    entries[frame].sharers    = nullptr;
+    entries[frame].numSharers = 0;
+}
+
+bool
+CoreMap::IsShared(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return entries[frame].sharers != nullptr;
+}
+
+unsigned
+CoreMap::CountSharers(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return entries[frame].numSharers;
+}
+
+#ifdef USE_TLB
+unsigned
+CoreMap::GetZeroFrame() const
+{
+    return zeroFrame;
+}
+
+bool
+CoreMap::IsZeroFrame(unsigned frame) const
+{
+    return (int) frame == zeroFrame;
+}
+#endif
+
+#ifdef USE_TLB
+/* Con el swap lleno, las víctimas que hay que guardar se saltean; si
+   fallan `numFrames` seguidas, se da por hecho que no queda ninguna que se
+   pueda desalojar.  Si todos los marcos están fijados, los que los fijaron
+   los van a soltar: se espera y se vuelve a buscar. */
+int
+CoreMap::FindOrEvict(AddressSpace *space, TranslationEntry *page)
+{
+    int frame = Find(space, page);
+    unsigned failed = 0;
+    while (frame < 0) {
+        int victim = NextVictim();
+        if (victim < 0) {
+            DEBUG('j', "Every frame is pinned, waiting.\n");
+            WaitForFrame();
+        } else {
+            stats->numSyncEvictions++;
+            if (Evict(victim))
+                failed = 0;
+            else if (++failed == numFrames)
+                return -1;
+        }
+        frame = Find(space, page);
+    }
+    return frame;
+}
+
+/* Como `AddressSpace::WaitForPage`: tomar el lock puede ceder el
+   procesador, así que se vuelve a mirar con el lock tomado. */
+void
+CoreMap::WaitForFrame()
+{
+    frameWaiters++;
+    frameLock->Acquire();
+    for (;;) {
+        bool available = freeMemMap->CountClear() > 0;
+        for (unsigned frame = 0; frame < numFrames && !available; frame++)
+            available = IsCandidate(frame);
+        if (available)
+            break;
+        frameAvailable->Wait();
+    }
+    frameLock->Release();
+    frameWaiters--;
+}
+#endif
+
+/* Sin nadie esperando no se toma el lock, así que soltar un marco no cede
+   el procesador. */
+void
+CoreMap::NotifyFrame()
+{
+    if (frameWaiters == 0)
+        return;
+    frameLock->Acquire();
+    frameAvailable->Broadcast();
+    frameLock->Release();
+}
+
+#ifdef USE_TLB
+static void
+PageoutThread(void *arg)
+{
+    ((CoreMap *) arg)->Pageout();
+}
+
+void
+CoreMap::StartPageout(unsigned low, unsigned high)
+{
+    ASSERT(pageoutWakeup == nullptr);
+    ASSERT(low > 0 && low <= high && high < numFrames);
+
+    lowWatermark  = low;
+    highWatermark = high;
+    pageoutWakeup = new Semaphore("pageout", 0);
+    Thread *t = new Thread("pageout");
+    t->Fork(PageoutThread, this);
+}
+
+/* Las páginas se desalojan de a una, así que entre una escritura al swap y
+   la siguiente los procesos pueden volver a tomar marcos libres: el daemon
+   sigue hasta que haya `highWatermark` libres a la vez, o hasta que el
+   swap se llena. */
+void
+CoreMap::Pageout()
+{
+    for (;;) {
+        pageoutWakeup->P();
+        DEBUG('j', "Pageout daemon woken up, %u free frames.\n",
+              freeMemMap->CountClear());
+        stats->numPageoutRuns++;
+        while (freeMemMap->CountClear() < highWatermark) {
+            // With every frame pinned, the faults that need one wait.
+            int victim = NextVictim();
+            if (victim < 0 || !Evict(victim))
+                break;
+            stats->numPagesPagedOut++;
+        }
+        pageoutAwake = false;
+    }
+}
+
+bool
+CoreMap::Evict(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(entries[frame].pinned > 0);
+
+    if (!IsShared(frame)) {
+        if (entries[frame].space->RemovePage(GetVirtualPage(frame)))
+            return true;
+        Unpin(frame);
+        return false;
+    }
+    // A page shared after a `Fork` may be modified with respect to the
+    // copy that each sharer would load, so each of them saves it in its
+    // swap.  It is unmapped from all of them first, so that none can take
+    // it for itself while it is being written.
+    unsigned vpn = GetVirtualPage(frame);
+    bool save = IsDirty(frame);
+    if (!ReserveSwapSlots(frame, vpn, save)) {
+        Unpin(frame);
+        return false;
+    }
+    DEBUG('j', "Evicting shared page %u of file %d.\n",
+          vpn, entries[frame].file);
+    // Saving it may let other threads run; a sharer that faults on the
+    // page meanwhile must not find this frame with `FindShared`.
+    entries[frame].file = -1;
+    List<AddressSpace *> unmapped;
+    while (!entries[frame].sharers->IsEmpty()) {
+        AddressSpace *space = entries[frame].sharers->Pop();
+        space->UnmapPage(vpn);
+        unmapped.Append(space);
+    }
+    while (!unmapped.IsEmpty())
+        unmapped.Pop()->FinishUnmap(vpn, frame, save);
+    Release(frame);
+    return true;
+}
+
+/* Los slots se toman antes de dejar de mapear la página en ninguno, así
+   que si falta alguno nada cambió; los que sí se tomaron quedan para la
+   próxima vez.  Tomarlos no cede el procesador. */
+bool
+CoreMap::ReserveSwapSlots(unsigned frame, unsigned vpn, bool save)
+{
+    List<AddressSpace *> *sharers = entries[frame].sharers;
+    List<AddressSpace *> checked;
+    bool reserved = true;
+    while (!sharers->IsEmpty()) {
+        AddressSpace *space = sharers->Pop();
+        reserved = reserved && space->ReserveSwapSlot(vpn, save);
+        checked.Append(space);
+    }
+    while (!checked.IsEmpty())
+        sharers->Append(checked.Pop());
+    return reserved;
+}
+#endif
+
+int
+CoreMap::NextVictim()
+{
+    int frame;
+    switch (policy) {
+        case PAGE_CLOCK:
+            frame = NextVictimClock();
+            break;
+        case PAGE_ESC:
+            frame = NextVictimESC();
+            break;
+        case PAGE_AGING:
+            frame = NextVictimAging();
+            break;
+        case PAGE_WSCLOCK:
+            frame = NextVictimWSClock();
+            break;
+        default:
+            frame = NextVictimFIFO();
+            break;
+    }
+    DEBUG('j', "Victim number (%s): %d\n", GetPolicyName(), frame);
+    if (frame >= 0)
+        entries[frame].pinned++;
+    return frame;
+}
+
+const char *
+CoreMap::GetPolicyName() const
+{
+    static const char *NAMES[] = {
+        "FIFO", "CLOCK", "enhanced second chance", "aging", "WSClock"
+    };
+    return NAMES[policy];
+}
+
+void
+CoreMap::Pin(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+    entries[frame].pinned++;
+}
+
+void
+CoreMap::Unpin(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(entries[frame].pinned > 0);
+    entries[frame].pinned--;
+    if (entries[frame].pinned == 0)
+        NotifyFrame();
+}
+
+AddressSpace *
+CoreMap::GetOwner(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return entries[frame].space;
+}
+
+TranslationEntry *
+CoreMap::GetPage(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return entries[frame].page;
+}
+
+unsigned
+CoreMap::GetVirtualPage(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    ASSERT(entries[frame].page != nullptr);
+    return entries[frame].page->virtualPage;
+}
+
+bool
+CoreMap::IsPinned(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return entries[frame].pinned > 0;
+}
+
+#ifdef USE_TLB
+/// The next entry of the TLB that maps `frame`, starting at `*i`, which is
+/// left after it; null if there are no more.  A shared frame can be mapped
+/// by an entry of every address space that shares it.
+static TranslationEntry *
+NextInTLB(unsigned frame, unsigned *i)
+{
+    MMU *mmu = machine->GetMMU();
+    for (; *i < mmu->GetTLBSize(); (*i)++)
+        if (mmu->tlb[*i].valid && mmu->tlb[*i].physicalPage == frame)
+            return &mmu->tlb[(*i)++];
+    return nullptr;
+}
+#endif
+
+/* Los bits de la TLB se copian a la tabla de páginas recién cuando la
+   entrada se reemplaza, así que hay que mirar los dos. */
+bool
+CoreMap::IsReferenced(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    if (entries[frame].page == nullptr)
+        return false;
+#ifdef USE_TLB
+    unsigned i = 0;
+    for (TranslationEntry *cached; (cached = NextInTLB(frame, &i)); )
+        if (cached->use)
+            return true;
+#endif
+    return entries[frame].page->use;
+}
+
+bool
+CoreMap::IsDirty(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    if (entries[frame].page == nullptr)
+        return false;
+#ifdef USE_TLB
+    unsigned i = 0;
+    for (TranslationEntry *cached; (cached = NextInTLB(frame, &i)); )
+        if (cached->dirty)
+            return true;
+#endif
+    return entries[frame].page->dirty;
+}
+
+void
+CoreMap::ClearDirty(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(entries[frame].page != nullptr);
+    entries[frame].page->dirty = false;
+#ifdef USE_TLB
+    unsigned i = 0;
+    for (TranslationEntry *cached; (cached = NextInTLB(frame, &i)); )
+        cached->dirty = false;
+#endif
+}
+
+bool
+CoreMap::IsUsed(unsigned frame) const
+{
+    return entries[frame].page != nullptr;
+}
+
+bool
+CoreMap::IsCandidate(unsigned frame) const
+{
+    return IsUsed(frame) && entries[frame].pinned == 0;
+}
+
+void
+CoreMap::ClearReferenced(unsigned frame)
+{
+    ASSERT(entries[frame].page != nullptr);
+    entries[frame].page->use = false;
+#ifdef USE_TLB
+    unsigned i = 0;
+    for (TranslationEntry *cached; (cached = NextInTLB(frame, &i)); )
+        cached->use = false;
+#endif
+}
+
+/* El primer marco de la cola que no esté fijado.  Los marcos libres que
+   quedaron en la cola se descartan y los fijados vuelven al final. */
+int
+CoreMap::NextVictimFIFO()
+{
+    for (unsigned tries = 0; tries <= 2 * numFrames; tries++) {
+        if (victims->IsEmpty())
+            break;
+        unsigned frame = victims->Pop();
+        if (!IsUsed(frame)) {
+            entries[frame].queued = false;
+            continue;
+        }
+        victims->Append(frame);
+        if (entries[frame].pinned == 0)
+            return frame;
+    }
+    return -1;
+}
+
+/* La aguja avanza limpiando el bit de uso hasta encontrar una página que no
+   haya sido referenciada desde la vuelta anterior.  Dos vueltas alcanzan
+   para limpiar todos los bits. */
+int
+CoreMap::NextVictimClock()
+{
+    for (unsigned tries = 0; tries <= 2 * numFrames; tries++) {
+        unsigned frame = hand;
+        hand = (hand + 1) % numFrames;
+        if (!IsCandidate(frame))
+            continue;
+        if (!IsReferenced(frame))
+            return frame;
+        ClearReferenced(frame);
+    }
+    return -1;
+}
+
+/* Las páginas se clasifican por (uso, modificada).  En las vueltas pares
+   se busca una (0, 0) sin tocar nada; en las impares una (0, 1), limpiando
+   el bit de uso de las que se saltean.  Después de cuatro vueltas todas
+   las páginas quedaron sin uso, así que alguna tuvo que ser elegida, salvo
+   que estén todas fijadas. */
+int
+CoreMap::NextVictimESC()
+{
+    for (unsigned turn = 0; turn < 4; turn++)
+        for (unsigned n = 0; n < numFrames; n++) {
+            unsigned frame = hand;
+            hand = (hand + 1) % numFrames;
+            if (!IsCandidate(frame))
+                continue;
+            bool wantDirty = turn % 2 == 1;
+            if (!IsReferenced(frame) && IsDirty(frame) == wantDirty)
+                return frame;
+            if (wantDirty)
+                ClearReferenced(frame);
+        }
+    return -1;
+}
+
+/* En cada reemplazo el contador de cada página se corre un bit a la
+   derecha y el bit de uso entra por la izquierda; la víctima es la de
+   menor contador, es decir, la usada hace más tiempo. */
+int
+CoreMap::NextVictimAging()
+{
+    unsigned victim = numFrames;
+    for (unsigned frame = 0; frame < numFrames; frame++) {
+        if (!IsUsed(frame))
+            continue;
+        entries[frame].age >>= 1;
+        if (IsReferenced(frame)) {
+            entries[frame].age |= 0x80;
+            ClearReferenced(frame);
+        }
+        if (entries[frame].pinned == 0
+              && (victim == numFrames
+                  || entries[frame].age < entries[victim].age))
+            victim = frame;
+    }
+    return victim < numFrames ? (int) victim : -1;
+}
+
+/* La aguja da una vuelta: las páginas referenciadas se marcan como usadas
+   ahora, y de las que quedaron fuera del conjunto de trabajo se elige la
+   primera sin modificar.  Si todas las viejas están modificadas se elige
+   la primera de ellas, y si no hay ninguna vieja, la usada hace más
+   tiempo. */
+int
+CoreMap::NextVictimWSClock()
+{
+    unsigned long now = stats->totalTicks;
+    unsigned oldDirty = numFrames;
+    unsigned oldest = numFrames;
+    for (unsigned n = 0; n < numFrames; n++) {
+        unsigned frame = hand;
+        hand = (hand + 1) % numFrames;
+        if (!IsCandidate(frame))
+            continue;
+        if (IsReferenced(frame)) {
+            ClearReferenced(frame);
+            entries[frame].lastUse = now;
+        } else if (now - entries[frame].lastUse > WORKING_SET_WINDOW) {
+            if (!IsDirty(frame))
+                return frame;
+            if (oldDirty == numFrames)
+                oldDirty = frame;
+        }
+        if (oldest == numFrames
+              || entries[frame].lastUse < entries[oldest].lastUse)
+            oldest = frame;
+    }
+    if (oldDirty < numFrames)
+        return oldDirty;
+    return oldest < numFrames ? (int) oldest : -1;
+}
@@ -0,0 +1,300 @@
+/// Data structures to keep track of the owner of every physical frame.
+///
+/// The core map is an inverted page table: it has one entry per frame of
+/// main memory, which records the address space and virtual page loaded in
+/// it.  When memory is full, the replacement algorithm picks a frame and the
+/// core map tells, without searching any page table, which page has to be
+/// sent to swap.
+///
+/// Frames can also be pinned while a page is being read into them or
+/// written out of them, so that the replacement algorithm does not pick
+/// them in the middle of the transfer.
+///
+/// The free frames themselves are still kept in `freeMemMap`.
+///
+/// Pages made only of code are shared, read-only, by every process running
+/// the same executable; they are found by the executable and virtual page
+/// they hold.  After a `Fork`, every page of the parent is shared with the
+/// child too, read-only until one of them writes it.  A shared frame has no
+/// single owner: it keeps the list of address spaces that map it.  Evicting
+/// it unmaps it from all of them, and it is freed when the last one exits.
+///
+/// With demand paging, one frame is kept filled with zeroes.  Pages that
+/// were never written and are not in the executable map it read-only, so
+/// reading them takes no frame; they get one of their own, zeroed then, the
+/// first time they are written.
+///
+/// A pageout daemon, a kernel thread, can keep a pool of free frames: it
+/// wakes up when fewer than a low watermark of frames are free, and evicts
+/// pages, saving the modified ones, until a high watermark are free.  This
+/// way a page fault seldom has to wait for a page to be written to swap
+/// before it can read its own page.
+///
+/// The replacement algorithm is chosen when the core map is created, among
+/// the ones in `PagePolicy`.  Every one of them looks at the `use` and
+/// `dirty` bits of the pages, taking into account the copies of those bits
+/// in the TLB, which are newer than the ones in the page tables.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_COREMAP__HH
+#define NACHOS_VMEM_COREMAP__HH
+
+
+#include "lib/list.hh"
+#include "machine/translation_entry.hh"
+
+
+class AddressSpace;
+class Condition;
+class Lock;
+class Semaphore;
+
+/// Page replacement algorithms.
+enum PagePolicy {
+    PAGE_FIFO,     ///< The page loaded first.
+    PAGE_CLOCK,    ///< Second chance: FIFO, but skipping referenced pages.
+    PAGE_ESC,      ///< Enhanced second chance: CLOCK, preferring pages that
+                   ///< were not modified, so they need no swap write.
+    PAGE_AGING,    ///< LRU approximation with a counter of recent uses.
+    PAGE_WSCLOCK   ///< CLOCK over the pages out of the working set of their
+                   ///< process, preferring the clean ones.
+};
+
+/// Ticks since its last use after which a page is considered out of the
+/// working set of its process by `PAGE_WSCLOCK` and by load control.
+const unsigned long WORKING_SET_WINDOW = 20000;
+
+/// What is known about a physical frame.
+struct CoreMapEntry {
+
+    /// The address space the page belongs to, or null if the frame is free
+    /// or shared.
+    AddressSpace *space;
+
+    /// The translation entry of the page in the page table of `space`, or
+    /// `shared` for a shared page; null if the frame is free.  Its `use`
+    /// and `dirty` bits tell whether the page was referenced or modified.
+    TranslationEntry *page;
+
+    /// Number of threads that need the frame to stay where it is; while it
+    /// is not zero, the replacement algorithm must not pick the frame.
+    unsigned pinned;
+
+    /// Whether the frame is in the FIFO queue of candidate victims.
+    bool queued;
+
+    /// For `PAGE_AGING`: the `use` bits sampled at the last replacements,
+    /// the most recent one in the highest bit.
+    unsigned char age;
+
+    /// For `PAGE_WSCLOCK`: time of the last replacement at which the page
+    /// was found referenced.
+    unsigned long lastUse;
+
+    /// For a shared page: the translation of the page, common to all of
+    /// the address spaces that map it.
+    TranslationEntry shared;
+
+    /// For a shared code page: the identifier of its executable (see
+    /// `OpenFile::GetSector`), or -1 for any other page.
+    int file;
+
+    /// For a shared page: the address spaces that map it, or null if the
+    /// page is private.
+    List<AddressSpace *> *sharers;
+
+    /// For a shared page: the number of address spaces in `sharers`.
+    unsigned numSharers;
+};
+
+class CoreMap {
+public:
+
+    /// Initialize a core map for `nframes` physical frames, all free, that
+    /// chooses victims with `policy`.
+    CoreMap(unsigned nframes, PagePolicy policy = PAGE_FIFO);
+
+    ~CoreMap();
+
+    /// Allocate a free frame for `page`, the translation entry of one of the
+    /// pages of `space`, and return its number.  The frame is returned
+    /// pinned, so that it can be filled safely.
+    ///
+    /// If there are no free frames, return -1.
+    int Find(AddressSpace *space, TranslationEntry *page);
+
+    /// Free `frame`.
+    void Release(unsigned frame);
+
+
+    /// Find the frame that holds the virtual page `vpn` of the executable
+    /// identified by `file`, shared.  If there is one, add `space` to the
+    /// address spaces that map it, pin it and return its number; otherwise
+    /// return -1.
+    int FindShared(int file, unsigned vpn, AddressSpace *space);
+
+    /// Share `frame`, that was just filled with the virtual page `vpn` of
+    /// the executable identified by `file` for its owner.  Return false,
+    /// leaving it private, if another frame already holds that page.
+    bool MakeShared(unsigned frame, int file, unsigned vpn);
+
+    /// Make the private `frame` shared, with its owner as the only address
+    /// space that maps it.
+    void Share(unsigned frame);
+
+    /// Add `space` to the address spaces that map the shared `frame`.
+    void AddSharer(unsigned frame, AddressSpace *space);
+
+    /// Remove `space` from the address spaces that map the shared `frame`,
+    /// and free it if it was the last one.
+    void Unshare(unsigned frame, AddressSpace *space);
+
+    /// Give the shared `frame`, mapped only by `space`, back to it as a
+    /// private frame whose translation entry is `page`.
+    void MakePrivate(unsigned frame, AddressSpace *space,
+                     TranslationEntry *page);
+
+    /// Whether `frame` holds a shared page.
+    bool IsShared(unsigned frame) const;
+
+#ifdef USE_TLB
+    /// The frame of zeroes, that is never freed nor evicted.
+    unsigned GetZeroFrame() const;
+
+    /// Whether `frame` is the frame of zeroes.
+    bool IsZeroFrame(unsigned frame) const;
+#endif
+
+    /// Number of address spaces that map the shared `frame`.
+    unsigned CountSharers(unsigned frame) const;
+
+#ifdef USE_TLB
+    /// Like `Find`, but if there are no free frames evict pages until one
+    /// is free, waiting for some frame to be unpinned if all of them are.
+    /// Return -1 only if no page can be evicted, because all of them have
+    /// to be saved and swap is full.
+    int FindOrEvict(AddressSpace *space, TranslationEntry *page);
+
+    /// Start the pageout daemon, which evicts pages whenever fewer than
+    /// `low` frames are free, until `high` of them are.
+    void StartPageout(unsigned low, unsigned high);
+
+    /// Body of the pageout daemon; it never returns.
+    void Pageout();
+
+    /// Take the page out of `frame`, that must be pinned by `NextVictim`,
+    /// and free it: a private page is removed by its owner, which saves it
+    /// if needed; a shared one is unmapped from every address space, and
+    /// saved by each of them if it was modified.  Return false, unpinning
+    /// the frame, if the page has to be saved and swap is full.
+    bool Evict(unsigned frame);
+#endif
+
+    /// Whether the free frames are below the low watermark of the pageout
+    /// daemon; they must not be used for anything but faults.
+    bool IsMemoryLow() const;
+
+    /// Choose a frame to evict with the replacement policy, and pin it.
+    /// Frames that are pinned are never chosen: return -1 if every frame
+    /// is.
+    int NextVictim();
+
+    /// Name of the replacement policy, for the statistics.
+    const char *GetPolicyName() const;
+
+    /// Forbid or allow again evicting `frame`.  Pins are counted, so the
+    /// frame can be evicted again after as many calls to `Unpin`.
+    void Pin(unsigned frame);
+    void Unpin(unsigned frame);
+
+    /// The address space whose page is in `frame`, or null if it is shared.
+    AddressSpace *GetOwner(unsigned frame) const;
+
+    /// The translation entry that keeps the `use` and `dirty` bits of the
+    /// page in `frame`.
+    TranslationEntry *GetPage(unsigned frame) const;
+
+    /// The virtual page held in `frame`.
+    unsigned GetVirtualPage(unsigned frame) const;
+
+    /// Whether `frame` is pinned.
+    bool IsPinned(unsigned frame) const;
+
+    /// Whether the page in `frame` was referenced or modified.
+    bool IsReferenced(unsigned frame) const;
+    bool IsDirty(unsigned frame) const;
+
+    /// Mark the page in `frame` as not modified, also in the TLB.  Used
+    /// once its contents are saved.
+    void ClearDirty(unsigned frame);
+
+    /// Clear the `use` bit of the page in `frame`, also in the TLB.
+    void ClearReferenced(unsigned frame);
+
+private:
+
+    /// Number of physical frames.
+    unsigned numFrames;
+
+    /// One entry per frame.
+    CoreMapEntry *entries;
+
+    PagePolicy policy;
+
+    /// Frame where the clock hand points, for the policies based on CLOCK.
+    unsigned hand;
+
+    /// Frame of zeroes, or -1 without demand paging.
+    int zeroFrame;
+
+    /// Frames in the order their pages were loaded, for `PAGE_FIFO`.
+    List<unsigned> *victims;
+
+    /// Free frames below which the pageout daemon wakes up, 0 if there is
+    /// no daemon; and free frames it leaves before sleeping again.
+    unsigned lowWatermark;
+    unsigned highWatermark;
+
+    /// Wakes up the pageout daemon.
+    Semaphore *pageoutWakeup;
+
+    /// Whether the pageout daemon was woken up and is not done yet.
+    bool pageoutAwake;
+
+    /// Threads waiting in `WaitForFrame`, and the condition they wait
+    /// on, signalled when a frame is unpinned or freed.
+    unsigned frameWaiters;
+    Lock *frameLock;
+    Condition *frameAvailable;
+
+    /// Wait until some frame is free or can be evicted.
+    void WaitForFrame();
+
+    /// Wake up the threads in `WaitForFrame`, if any.
+    void NotifyFrame();
+
+    /// Whether `frame` holds a page.
+    bool IsUsed(unsigned frame) const;
+
+    /// Whether `frame` holds a page that can be evicted.
+    bool IsCandidate(unsigned frame) const;
+
+#ifdef USE_TLB
+    /// Take a swap slot for page `vpn` in every address space that shares
+    /// `frame` and has to save it.  Return false if swap is full.
+    bool ReserveSwapSlots(unsigned frame, unsigned vpn, bool save);
+#endif
+
+    /// The victim chosen by each policy, or -1 if every frame is pinned.
+    int NextVictimFIFO();
+    int NextVictimClock();
+    int NextVictimESC();
+    int NextVictimAging();
+    int NextVictimWSClock();
+};
+
+
+#endif
@@ -0,0 +1,217 @@
+/// Routines of the medium-term scheduler.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "load_control.hh"
+#include "threads/system.hh"
+#include "threads/synch.hh"
+#include "userprog/address_space.hh"
+
+
+#ifdef USE_TLB
+LoadControl::LoadControl(unsigned nframes, unsigned high, unsigned low)
+{
+    ASSERT(nframes > 0);
+    ASSERT(low <= high);
+
+    numFrames     = nframes;
+    highFaults    = high;
+    lowFaults     = low;
+    active        = new List<AddressSpace *>;
+    numActive     = 0;
+    suspended     = new List<AddressSpace *>;
+    swapping      = nullptr;
+    lock          = new Lock("load control");
+    resumed       = new Condition("resumed", lock);
+    wakeup        = new Semaphore("load control", 0);
+    awake         = false;
+    faults        = 0;
+    lastSample    = 0;
+    lastUserTicks = 0;
+    demand        = 0;
+}
+
+LoadControl::~LoadControl()
+{
+    delete active;
+    delete suspended;
+    delete resumed;
+    delete lock;
+    delete wakeup;
+}
+
+static void
+LoadControlThread(void *arg)
+{
+    ((LoadControl *) arg)->Run();
+}
+
+void
+LoadControl::Start()
+{
+    Thread *t = new Thread("load control");
+    t->Fork(LoadControlThread, this);
+}
+
+void
+LoadControl::Run()
+{
+    for (;;) {
+        wakeup->P();
+        Sample();
+        awake = false;
+    }
+}
+
+/* Se llama con las interrupciones deshabilitadas, así que no puede tomar
+   el lock: sólo despierta al hilo. */
+void
+LoadControl::Tick()
+{
+    if (!awake && stats->totalTicks - lastSample >= LOAD_CONTROL_INTERVAL) {
+        awake = true;
+        wakeup->V();
+    }
+}
+
+unsigned
+LoadControl::Demand(AddressSpace *space) const
+{
+    unsigned pages = space->GetWorkingSet();
+    return pages < MIN_WORKING_SET ? MIN_WORKING_SET : pages;
+}
+
+/* Un programa nuevo entra si es el único o si su working set entra junto
+   con los de los activos; si no, queda suspendido y espera en su primer
+   fallo de página. */
+void
+LoadControl::Admit(AddressSpace *space)
+{
+    ASSERT(space != nullptr);
+
+    lock->Acquire();
+    if (numActive == 0 || demand + Demand(space) <= numFrames) {
+        active->Prepend(space);
+        numActive++;
+        demand += Demand(space);
+    } else {
+        DEBUG('j', "Program admitted suspended, demand %u.\n", demand);
+        suspended->Append(space);
+        stats->numAdmissionsDeferred++;
+    }
+    lock->Release();
+}
+
+/* Si el programa se está desalojando, hay que esperar a que termine: el
+   hilo de control de carga todavía toca su espacio de direcciones.  Al
+   salir libera marcos, así que puede haber lugar para otro. */
+void
+LoadControl::Remove(AddressSpace *space)
+{
+    ASSERT(space != nullptr);
+
+    lock->Acquire();
+    while (swapping == space)
+        resumed->Wait();
+    if (suspended->Has(space))
+        suspended->Remove(space);
+    else if (active->Has(space)) {
+        active->Remove(space);
+        numActive--;
+        unsigned pages = Demand(space);
+        demand = demand > pages ? demand - pages : 0;
+    }
+    lock->Release();
+
+    if (!awake) {
+        awake = true;
+        wakeup->V();
+    }
+}
+
+void
+LoadControl::PageFault(AddressSpace *space)
+{
+    ASSERT(space != nullptr);
+
+    faults++;
+    if (!suspended->Has(space))
+        return;
+    lock->Acquire();
+    while (suspended->Has(space))
+        resumed->Wait();
+    lock->Release();
+}
+
+/* Se suspende un programa si los fallos son frecuentes y los working sets
+   no entran en memoria, siempre que quede otro activo.  Se reanuda uno si
+   no queda ninguno activo, o si los fallos son raros y su working set
+   entra con los demás; así, entre los dos umbrales no se hace nada. */
+void
+LoadControl::Sample()
+{
+    unsigned long userTicks = stats->userTicks - lastUserTicks;
+    unsigned long rate = userTicks > 0 ? faults * 1000 / userTicks : 0;
+    lastSample    = stats->totalTicks;
+    lastUserTicks = stats->userTicks;
+    faults        = 0;
+
+    lock->Acquire();
+    demand = 0;
+    for (unsigned i = 0; i < numActive; i++) {
+        AddressSpace *space = active->Pop();
+        space->SampleWorkingSet();
+        demand += Demand(space);
+        active->Append(space);
+    }
+    DEBUG('j', "Load control: %u active, demand %u frames, %lu faults "
+          "per 1000 instructions.\n", numActive, demand, rate);
+
+    if (rate > highFaults && demand > numFrames && numActive > 1)
+        SuspendOne();
+    else if (!suspended->IsEmpty()
+               && (numActive == 0
+                   || (rate < lowFaults
+                       && demand + Demand(suspended->Head()) <= numFrames)))
+        ResumeOne();
+    lock->Release();
+}
+
+/* El programa se marca suspendido antes de desalojarlo, así que si falla
+   mientras tanto ya espera.  Desalojarlo escribe en el swap, y por eso se
+   suelta el lock. */
+void
+LoadControl::SuspendOne()
+{
+    AddressSpace *space = active->Pop();
+    numActive--;
+    demand -= Demand(space);
+    suspended->Append(space);
+    swapping = space;
+    stats->numProcessesSuspended++;
+    DEBUG('j', "Suspending a program with a working set of %u pages.\n",
+          space->GetWorkingSet());
+
+    lock->Release();
+    space->SwapOut();
+    lock->Acquire();
+
+    swapping = nullptr;
+    resumed->Broadcast();
+}
+
+void
+LoadControl::ResumeOne()
+{
+    AddressSpace *space = suspended->Pop();
+    active->Prepend(space);
+    numActive++;
+    demand += Demand(space);
+    stats->numProcessesResumed++;
+    DEBUG('j', "Resuming a program, demand %u frames.\n", demand);
+    resumed->Broadcast();
+}
+#endif
@@ -0,0 +1,127 @@
+/// Data structures to keep the running programs from thrashing.
+///
+/// When the pages that the running programs use at the same time do not
+/// fit in main memory, every one of them faults continuously and the CPU
+/// stays idle waiting for the swap disk.  Load control is a medium-term
+/// scheduler that avoids it by letting fewer programs compete for memory.
+///
+/// The working set of each address space is estimated from the `use` bits
+/// of its pages: the pages referenced in the last `WORKING_SET_WINDOW`
+/// ticks.  A kernel thread samples them periodically, together with the
+/// page fault frequency of the whole system, in faults per thousand user
+/// instructions.  When faults are frequent and the working sets add up to
+/// more than main memory, the program admitted last is suspended: its
+/// pages are swapped out, and it waits at its next page fault.  Suspended
+/// programs are resumed, the oldest first, when faults become rare and
+/// their working set fits again, or when no program is left running.
+///
+/// New programs are admitted the same way: one whose working set does not
+/// fit starts suspended.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_LOADCONTROL__HH
+#define NACHOS_VMEM_LOADCONTROL__HH
+
+
+#include "lib/list.hh"
+
+
+class AddressSpace;
+class Condition;
+class Lock;
+class Semaphore;
+
+/// Ticks between two samples of the working sets.
+const unsigned long LOAD_CONTROL_INTERVAL = 5000;
+
+/// Pages assumed for the working set of a program that has not been
+/// sampled yet, or that seems to use fewer.
+const unsigned MIN_WORKING_SET = 4;
+
+class LoadControl {
+public:
+
+    /// Initialize load control for `nframes` physical frames.  Programs
+    /// are suspended when there are more than `high` page faults per
+    /// thousand user instructions, and resumed when there are fewer than
+    /// `low`.
+    LoadControl(unsigned nframes, unsigned high, unsigned low);
+
+    ~LoadControl();
+
+    /// Start the kernel thread that samples the working sets.
+    void Start();
+
+    /// Body of that thread; it never returns.
+    void Run();
+
+    /// Called on every timer interrupt: wake up the thread if it is time
+    /// to sample again.
+    void Tick();
+
+    /// Start tracking `space`, of a new program; it is suspended right away
+    /// if there is no room for it.
+    void Admit(AddressSpace *space);
+
+    /// Stop tracking `space`, because its program is exiting.
+    void Remove(AddressSpace *space);
+
+    /// Count a page fault of `space`, and wait until it is resumed if it is
+    /// suspended.
+    void PageFault(AddressSpace *space);
+
+private:
+
+    unsigned numFrames;
+
+    /// Page fault frequencies that suspend and resume programs.
+    unsigned highFaults;
+    unsigned lowFaults;
+
+    /// Programs allowed to run, the one admitted or resumed last first, and
+    /// how many they are.
+    List<AddressSpace *> *active;
+    unsigned numActive;
+
+    /// Programs suspended, the oldest first.
+    List<AddressSpace *> *suspended;
+
+    /// Program whose pages are being swapped out, or null.
+    AddressSpace *swapping;
+
+    /// Protects the fields above; `resumed` is signalled when a program is
+    /// resumed or done being swapped out.
+    Lock *lock;
+    Condition *resumed;
+
+    /// Wakes up the thread, and whether it was woken up and is not done.
+    Semaphore *wakeup;
+    bool awake;
+
+    /// Page faults since the last sample; time and user instructions at it.
+    unsigned long faults;
+    unsigned long lastSample;
+    unsigned long lastUserTicks;
+
+    /// Sum of the working sets of the active programs, at the last sample.
+    unsigned demand;
+
+    /// Frames that `space` is expected to need.
+    unsigned Demand(AddressSpace *space) const;
+
+    /// Sample the working sets and the fault frequency, and suspend or
+    /// resume a program if needed.
+    void Sample();
+
+    /// Suspend the program admitted last and swap it out.
+    void SuspendOne();
+
+    /// Resume the oldest suspended program.
+    void ResumeOne();
+};
+
+
+#endif
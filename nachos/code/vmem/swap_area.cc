@@ -0,0 +1,145 @@
+/// Routines to manage the swap area.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "swap_area.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+SwapArea::SwapArea(const char *name, unsigned cacheSize)
+{
+    ASSERT(name != nullptr);
+
+    disk  = new SynchDisk(name);
+    slots = new Bitmap(NUM_SWAP_SLOTS);
+    cache = new SwapCache(NUM_SWAP_SLOTS, cacheSize);
+    spilling           = new Bitmap(NUM_SWAP_SLOTS);
+    freedWhileSpilling = new Bitmap(NUM_SWAP_SLOTS);
+}
+
+SwapArea::~SwapArea()
+{
+    delete freedWhileSpilling;
+    delete spilling;
+    delete cache;
+    delete slots;
+    delete disk;
+}
+
+int
+SwapArea::Allocate()
+{
+    return slots->Find();
+}
+
+int
+SwapArea::AllocateRun(unsigned count, unsigned hint)
+{
+    return slots->FindContiguous(count, hint);
+}
+
+void
+SwapArea::Free(unsigned slot)
+{
+    ASSERT(slot < NUM_SWAP_SLOTS);
+    ASSERT(slots->Test(slot));
+
+    cache->Drop(slot);
+    if (spilling->Test(slot))
+        freedWhileSpilling->Mark(slot);
+    else
+        slots->Clear(slot);
+}
+
+void
+SwapArea::ReadPage(unsigned slot, char *data)
+{
+    ASSERT(slot < NUM_SWAP_SLOTS);
+    ASSERT(data != nullptr);
+
+    if (cache->Read(slot, data)) {
+        stats->numSwapCacheHits++;
+        return;
+    }
+    stats->numSwapCacheMisses++;
+    ReadFromDisk(slot, data);
+}
+
+/* Si el pool desborda, quien escribio la ultima pagina saca al disco las
+   mas viejas hasta que vuelva a entrar. */
+void
+SwapArea::WritePage(unsigned slot, const char *data)
+{
+    ASSERT(slot < NUM_SWAP_SLOTS);
+    ASSERT(data != nullptr);
+
+    if (!cache->Write(slot, data)) {
+        WriteToDisk(slot, data);
+        return;
+    }
+    // Spilling happens while evicting, deep in the stack of the thread,
+    // and a big page may not fit in it.
+    unsigned victim;
+    char *page = new char [PAGE_SIZE];
+    while (cache->StartSpill(&victim, page)) {
+        DEBUG('s', "Spilling swap slot %u to disk.\n", victim);
+        stats->numPagesSpilled++;
+        spilling->Mark(victim);
+        WriteToDisk(victim, page);
+        spilling->Clear(victim);
+        cache->FinishSpill(victim);
+        if (freedWhileSpilling->Test(victim)) {
+            freedWhileSpilling->Clear(victim);
+            slots->Clear(victim);
+        }
+    }
+    delete [] page;
+}
+
+/* Las copias de las paginas que quedaban en el cache ya no sirven.  Los
+   slots son consecutivos, asi que los sectores tambien: el disco los
+   escribe uno detras del otro, sin volver a buscar la pista. */
+void
+SwapArea::WriteRun(unsigned slot, const char *data, unsigned count)
+{
+    ASSERT(count > 0 && slot + count <= NUM_SWAP_SLOTS);
+    ASSERT(data != nullptr);
+
+    for (unsigned i = 0; i < count; i++)
+        cache->Drop(slot + i);
+    for (unsigned i = 0; i < count; i++)
+        WriteToDisk(slot + i, &data[i * PAGE_SIZE]);
+}
+
+/* Una pagina ocupa sectores consecutivos a partir del primero del slot. */
+void
+SwapArea::ReadFromDisk(unsigned slot, char *data)
+{
+    char sector[SECTOR_SIZE];
+    for (unsigned i = 0; i < SECTORS_PER_PAGE; i++) {
+        unsigned offset = i * SECTOR_SIZE;
+        unsigned size   = PAGE_SIZE - offset < SECTOR_SIZE
+                          ? PAGE_SIZE - offset : SECTOR_SIZE;
+        disk->ReadSector(slot * SECTORS_PER_PAGE + i, sector);
+        memcpy(&data[offset], sector, size);
+    }
+}
+
+void
+SwapArea::WriteToDisk(unsigned slot, const char *data)
+{
+    char sector[SECTOR_SIZE];
+    for (unsigned i = 0; i < SECTORS_PER_PAGE; i++) {
+        unsigned offset = i * SECTOR_SIZE;
+        unsigned size   = PAGE_SIZE - offset < SECTOR_SIZE
+                          ? PAGE_SIZE - offset : SECTOR_SIZE;
+        memset(sector, 0, SECTOR_SIZE);
+        memcpy(sector, &data[offset], size);
+        disk->WriteSector(slot * SECTORS_PER_PAGE + i, sector);
+    }
+}
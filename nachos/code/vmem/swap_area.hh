@@ -0,0 +1,88 @@
+/// Data structures to keep the pages sent out of main memory.
+///
+/// Swap lives in a disk of its own, separate from the one that holds the
+/// file system, so paging never goes through files, directories or their
+/// locks.  The disk is divided in slots of one page each, and a bitmap
+/// tells which of them are in use.  Address spaces take a slot the first
+/// time one of their pages is written out, keep it while they live, and
+/// give all of them back when the program exits.  Pages saved together
+/// move to a run of consecutive slots if theirs are not already one.
+///
+/// Pages written to a slot are first kept compressed in memory, in a
+/// `SwapCache`; only the ones that overflow it, or do not compress, are
+/// written to the disk.  A run of pages saved together goes straight to
+/// consecutive slots of the disk instead, in a single transfer.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_SWAPAREA__HH
+#define NACHOS_VMEM_SWAPAREA__HH
+
+
+#include "swap_cache.hh"
+#include "filesys/synch_disk.hh"
+#include "lib/bitmap.hh"
+#include "machine/mmu.hh"
+
+
+/// Number of disk sectors that hold a page.
+const unsigned SECTORS_PER_PAGE = DivRoundUp(PAGE_SIZE, SECTOR_SIZE);
+
+/// Number of pages that fit in the swap disk.
+const unsigned NUM_SWAP_SLOTS = NUM_SECTORS / SECTORS_PER_PAGE;
+
+class SwapArea {
+public:
+
+    /// Initialize a swap area over the simulated disk stored in the UNIX
+    /// file `name`, with every slot free, that keeps up to `cacheSize`
+    /// bytes of compressed pages in memory.
+    SwapArea(const char *name, unsigned cacheSize);
+
+    ~SwapArea();
+
+    /// Take a free slot and return its number, or -1 if swap is full.
+    int Allocate();
+
+    /// Take `count` consecutive free slots, as near `hint` as possible, and
+    /// return the first one, or -1 if there is no such run.
+    int AllocateRun(unsigned count, unsigned hint);
+
+    /// Give back `slot`.
+    void Free(unsigned slot);
+
+    /// Read into `data` the page kept in `slot`.
+    void ReadPage(unsigned slot, char *data);
+
+    /// Keep in `slot` the page in `data`.
+    void WritePage(unsigned slot, const char *data);
+
+    /// Write the `count` pages in `data` to the disk, in the slots that
+    /// start at `slot`, bypassing the cache.
+    void WriteRun(unsigned slot, const char *data, unsigned count);
+
+private:
+
+    SynchDisk *disk;
+
+    /// Slots in use.
+    Bitmap *slots;
+
+    /// Pages of the slots kept in memory.
+    SwapCache *cache;
+
+    /// Slots whose page is being spilled to the disk, and those among them
+    /// that were freed meanwhile: they are not given out again until the
+    /// spill is over, or it would overwrite the page of their new owner.
+    Bitmap *spilling;
+    Bitmap *freedWhileSpilling;
+
+    /// Transfer the page of `slot` from or to the disk.
+    void ReadFromDisk(unsigned slot, char *data);
+    void WriteToDisk(unsigned slot, const char *data);
+};
+
+
+#endif
@@ -0,0 +1,237 @@
+/// Routines to keep pages sent to swap compressed in memory.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "swap_cache.hh"
+#include "machine/mmu.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+/// A compressed page is a sequence of codes.  A code below `MATCH_CODE` is
+/// followed by that many plus one literal bytes; any other one stands for
+/// `code - MATCH_CODE + MIN_MATCH` bytes equal to the ones that start the
+/// number of bytes before given by the two bytes that follow it.
+static const unsigned MATCH_CODE   = 0x80;
+static const unsigned MAX_LITERALS = MATCH_CODE;
+static const unsigned MIN_MATCH    = 3;
+static const unsigned MAX_MATCH    = MIN_MATCH + 0xFF - MATCH_CODE;
+static const unsigned MAX_DISTANCE = 0xFFFF;
+
+/// Entries of the table of positions seen, by hash of their first bytes.
+static const unsigned HASH_SIZE = 256;
+
+/// Room needed to compress a page that does not compress at all.
+static const unsigned COMPRESS_BOUND = PAGE_SIZE
+                                       + DivRoundUp(PAGE_SIZE, MAX_LITERALS);
+
+static inline unsigned
+Hash(const unsigned char *bytes)
+{
+    return (bytes[0] * 33 * 33 + bytes[1] * 33 + bytes[2]) % HASH_SIZE;
+}
+
+static void
+EmitLiterals(const unsigned char *page, unsigned from, unsigned to,
+             char *out, unsigned *size)
+{
+    while (from < to) {
+        unsigned count = to - from < MAX_LITERALS ? to - from : MAX_LITERALS;
+        out[(*size)++] = count - 1;
+        memcpy(&out[*size], &page[from], count);
+        *size += count;
+        from += count;
+    }
+}
+
+/* Recorre la página buscando, en cada posición, la última anterior cuyos
+   primeros bytes tienen el mismo hash; si coinciden al menos `MIN_MATCH`
+   bytes se emite una referencia, y si no el byte queda como literal.
+   Devuelve el tamaño comprimido, que puede superar al de la página. */
+static unsigned
+Compress(const char *data, char *out)
+{
+    const unsigned char *page = (const unsigned char *) data;
+    int last[HASH_SIZE];
+    for (unsigned i = 0; i < HASH_SIZE; i++)
+        last[i] = -1;
+
+    unsigned size = 0, literals = 0, i = 0;
+    while (i < PAGE_SIZE) {
+        unsigned length = 0, distance = 0;
+        if (i + MIN_MATCH <= PAGE_SIZE) {
+            unsigned h = Hash(&page[i]);
+            int candidate = last[h];
+            last[h] = i;
+            if (candidate >= 0 && i - candidate <= MAX_DISTANCE) {
+                distance = i - candidate;
+                while (length < MAX_MATCH && i + length < PAGE_SIZE
+                         && page[candidate + length] == page[i + length])
+                    length++;
+            }
+        }
+        if (length < MIN_MATCH) {
+            i++;
+            continue;
+        }
+        EmitLiterals(page, literals, i, out, &size);
+        out[size++] = MATCH_CODE + length - MIN_MATCH;
+        out[size++] = distance & 0xFF;
+        out[size++] = distance >> 8;
+        i += length;
+        literals = i;
+    }
+    EmitLiterals(page, literals, PAGE_SIZE, out, &size);
+    return size;
+}
+
+/* Una referencia puede solaparse con los bytes que ella misma produce, por
+   eso se copia de a un byte. */
+static void
+Decompress(const char *compressed, unsigned size, char *page)
+{
+    const unsigned char *in = (const unsigned char *) compressed;
+    unsigned i = 0, o = 0;
+    while (i < size) {
+        unsigned code = in[i++];
+        if (code < MATCH_CODE) {
+            unsigned count = code + 1;
+            ASSERT(i + count <= size && o + count <= PAGE_SIZE);
+            memcpy(&page[o], &in[i], count);
+            i += count;
+            o += count;
+        } else {
+            ASSERT(i + 2 <= size);
+            unsigned length   = code - MATCH_CODE + MIN_MATCH;
+            unsigned distance = in[i] | in[i + 1] << 8;
+            i += 2;
+            ASSERT(distance > 0 && distance <= o && o + length <= PAGE_SIZE);
+            for (unsigned k = 0; k < length; k++, o++)
+                page[o] = page[o - distance];
+        }
+    }
+    ASSERT(o == PAGE_SIZE);
+}
+
+SwapCache::SwapCache(unsigned nslots, unsigned capacity_)
+{
+    numSlots = nslots;
+    capacity = capacity_;
+    used     = 0;
+    pages    = new CachedPage *[numSlots];
+    for (unsigned i = 0; i < numSlots; i++)
+        pages[i] = nullptr;
+    order = new List<unsigned>;
+}
+
+SwapCache::~SwapCache()
+{
+    for (unsigned i = 0; i < numSlots; i++)
+        Drop(i);
+    delete [] pages;
+    delete order;
+}
+
+bool
+SwapCache::Read(unsigned slot, char *data)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(data != nullptr);
+
+    CachedPage *page = pages[slot];
+    if (page == nullptr)
+        return false;
+    if (page->data == nullptr)
+        memset(data, 0, PAGE_SIZE);
+    else
+        Decompress(page->data, page->size, data);
+    return true;
+}
+
+/* Una página que al comprimirse no achica no vale el lugar que ocuparía
+   en el pool: va directo al disco. */
+bool
+SwapCache::Write(unsigned slot, const char *data)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(data != nullptr);
+
+    Drop(slot);
+
+    unsigned first = 0;
+    while (first < PAGE_SIZE && data[first] == 0)
+        first++;
+    if (first == PAGE_SIZE) {
+        pages[slot] = new CachedPage {nullptr, 0, false};
+        stats->numZeroPagesCached++;
+        return true;
+    }
+
+    // More than a page, too much for the stack of the thread if pages are
+    // big.
+    char *buffer = new char [COMPRESS_BOUND];
+    unsigned size = Compress(data, buffer);
+    if (size >= PAGE_SIZE) {
+        delete [] buffer;
+        stats->numPagesIncompressible++;
+        return false;
+    }
+    char *compressed = new char [size];
+    memcpy(compressed, buffer, size);
+    delete [] buffer;
+    pages[slot] = new CachedPage {compressed, size, false};
+    used += size;
+    order->Append(slot);
+    stats->numPagesCompressed++;
+    stats->numCompressedBytes += size;
+    return true;
+}
+
+void
+SwapCache::Drop(unsigned slot)
+{
+    ASSERT(slot < numSlots);
+
+    CachedPage *page = pages[slot];
+    if (page == nullptr)
+        return;
+    if (page->data != nullptr && !page->spilling) {
+        used -= page->size;
+        order->Remove(slot);
+    }
+    delete [] page->data;
+    delete page;
+    pages[slot] = nullptr;
+}
+
+bool
+SwapCache::StartSpill(unsigned *slot, char *data)
+{
+    ASSERT(slot != nullptr);
+    ASSERT(data != nullptr);
+
+    if (used <= capacity || order->IsEmpty())
+        return false;
+    *slot = order->Pop();
+    CachedPage *page = pages[*slot];
+    ASSERT(page != nullptr && page->data != nullptr && !page->spilling);
+    Decompress(page->data, page->size, data);
+    page->spilling = true;
+    used -= page->size;
+    return true;
+}
+
+/* Mientras se escribía, la página pudo haberse reemplazado por otra más
+   nueva, o liberado; en ese caso ya no es la que se estaba sacando. */
+void
+SwapCache::FinishSpill(unsigned slot)
+{
+    ASSERT(slot < numSlots);
+
+    if (pages[slot] != nullptr && pages[slot]->spilling)
+        Drop(slot);
+}
@@ -0,0 +1,91 @@
+/// Data structures to keep pages sent to swap compressed in memory.
+///
+/// Between main memory and the swap disk there is a pool of compressed
+/// pages, kept in the memory of the host, out of the reach of the user
+/// programs.  A page written to swap is compressed and kept in the pool; it
+/// only reaches the disk when the pool overflows, oldest first, or if it
+/// does not compress at all.  Reading it back then costs a decompression
+/// instead of a disk transfer.
+///
+/// Pages made only of zeroes, which are common in stacks and uninitialized
+/// data, take no room in the pool at all and never reach the disk.
+///
+/// The compressor is a small member of the LZ77 family: the page is
+/// encoded as runs of literal bytes and references to repeated sequences
+/// earlier in the same page, found through a hash of their first bytes.
+///
+/// Copyright (c) 2016-2020 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_SWAPCACHE__HH
+#define NACHOS_VMEM_SWAPCACHE__HH
+
+
+#include "lib/list.hh"
+
+
+/// A page kept in the pool.
+struct CachedPage {
+
+    /// Compressed contents, or null if the page is all zeroes.
+    char *data;
+
+    /// Number of bytes in `data`.
+    unsigned size;
+
+    /// Whether the page is being written to disk to make room; it can
+    /// still be read from the pool until that is over.
+    bool spilling;
+};
+
+/// The compressed pages of the swap area, by slot.  Mutual exclusion is
+/// provided by the absence of interrupts while its methods run; only the
+/// disk transfers done by `SwapArea` between them let other threads in.
+class SwapCache {
+public:
+
+    /// Initialize an empty pool for `nslots` swap slots, that can hold up
+    /// to `capacity` bytes of compressed pages.
+    SwapCache(unsigned nslots, unsigned capacity);
+
+    ~SwapCache();
+
+    /// If `slot` is in the pool, copy its page into `data` and return true.
+    bool Read(unsigned slot, char *data);
+
+    /// Keep `data` as the new page of `slot`, compressed, and return true;
+    /// the pool may overflow, see `StartSpill`.  Return false if the page
+    /// does not compress, so the caller has to write it to the disk.
+    bool Write(unsigned slot, const char *data);
+
+    /// Forget the page of `slot`, if it is in the pool.
+    void Drop(unsigned slot);
+
+    /// If the pool holds more than its capacity, take its oldest page to
+    /// be written to the disk, copying it into `data`, and return true.
+    /// The page stays readable until `FinishSpill` is called for it.
+    bool StartSpill(unsigned *slot, char *data);
+
+    /// The page of `slot` taken by `StartSpill` is on the disk.
+    void FinishSpill(unsigned slot);
+
+private:
+
+    unsigned numSlots;
+
+    /// Bytes of compressed pages the pool can hold, and it holds, not
+    /// counting the ones being spilled.
+    unsigned capacity;
+    unsigned used;
+
+    /// The page kept for each slot, or null if it is not in the pool.
+    CachedPage **pages;
+
+    /// Slots with a compressed page that is not being spilled, the oldest
+    /// first.
+    List<unsigned> *order;
+};
+
+
+#endif